@@ -0,0 +1,172 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define ALIGN_UP( N ) ( ( ( N )+ARENA_ALIGN-1 ) & ~( size_t )( ARENA_ALIGN-1 ) )
+
+#define BLOCK_HEADER ALIGN_UP( sizeof( arena_block_t ) )
+
+_Thread_local arena_t* current_arena = NULL;
+
+arena_t*
+use_arena( arena_t* a ) {
+    arena_t* prev   = current_arena;
+    current_arena   = a;
+    return prev;
+}
+
+arena_t*
+new_arena( void ) {
+    arena_t* a  = calloc( 1, sizeof( arena_t ) );
+    if( a ) {
+        a->grow = ARENA_MIN_BLOCK;
+    }
+    return a;
+}
+
+static arena_block_t*
+new_block( size_t size ) {
+    // blocks are never reused, so the zeroed memory of
+    // calloc is what every allocation starts with
+    arena_block_t* b    = calloc( 1, BLOCK_HEADER+size );
+    if( b ) {
+        b->size         = size;
+    }
+    return b;
+}
+
+void*
+arena_alloc(
+    arena_t* a,
+    size_t   size
+) {
+    if( !a || size>SIZE_MAX/2 ) {
+        return NULL;
+    }
+    size = ALIGN_UP( size ? size : 1 );
+    if( size<=( size_t )( a->end-a->next ) ) {
+        void* p     = a->next;
+        a->next    += size;
+        return p;
+    }
+    if( size>ARENA_MAX_BLOCK/4 ) {
+        // large allocations go behind the first block,
+        // which keeps its unused part
+        arena_block_t* b    = new_block( size );
+        if( !b ) {
+            return NULL;
+        }
+        if( a->blocks ) {
+            b->next         = a->blocks->next;
+            a->blocks->next = b;
+        }
+        else {
+            a->blocks       = b;
+        }
+        return ( char* )b+BLOCK_HEADER;
+    }
+    while( a->grow<size ) {
+        a->grow    *= 2;
+    }
+    arena_block_t* b    = new_block( a->grow );
+    if( !b ) {
+        return NULL;
+    }
+    b->next         = a->blocks;
+    a->blocks       = b;
+    a->next         = ( char* )b+BLOCK_HEADER+size;
+    a->end          = ( char* )b+BLOCK_HEADER+b->size;
+    if( a->grow<ARENA_MAX_BLOCK ) {
+        a->grow    *= 2;
+    }
+    return ( char* )b+BLOCK_HEADER;
+}
+
+char*
+arena_strndup(
+    arena_t*    a,
+    const char* s,
+    size_t      len
+) {
+    char* d = arena_alloc( a, len+1 );
+    if( d ) {
+        memcpy( d, s, len );
+    }
+    return d;
+}
+
+void*
+arena_realloc(
+    arena_t* a,
+    void*    p,
+    size_t   size
+) {
+    if( !p ) {
+        char* q = arena_alloc( a, ARENA_ALIGN+size );
+        if( !q ) {
+            return NULL;
+        }
+        memcpy( q, &size, sizeof( size_t ) );
+        return q+ARENA_ALIGN;
+    }
+    char*  q    = ( char* )p-ARENA_ALIGN;
+    size_t old;
+    memcpy( &old, q, sizeof( size_t ) );
+    if( size<=old ) {
+        return p;
+    }
+    // the last allocation of the first block can grow
+    // into its unused part
+    if( ( char* )p+ALIGN_UP( old )==a->next &&
+        ALIGN_UP( size )-ALIGN_UP( old )<=( size_t )( a->end-a->next ) ) {
+        a->next    += ALIGN_UP( size )-ALIGN_UP( old );
+        memcpy( q, &size, sizeof( size_t ) );
+        return p;
+    }
+    char* r     = arena_realloc( a, NULL, size );
+    if( r ) {
+        memcpy( r, p, old );
+    }
+    return r;
+}
+
+void
+arena_adopt(
+    arena_t* a,
+    arena_t* other
+) {
+    if( !other ) {
+        return;
+    }
+    if( other->blocks ) {
+        arena_block_t* last = other->blocks;
+        while( last->next ) {
+            last        = last->next;
+        }
+        // the first block of `a` stays the one allocated from
+        if( a->blocks ) {
+            last->next      = a->blocks->next;
+            a->blocks->next = other->blocks;
+        }
+        else {
+            a->blocks       = other->blocks;
+        }
+    }
+    free( other );
+}
+
+void
+delete_arena( arena_t* a ) {
+    if( !a ) {
+        return;
+    }
+    arena_block_t* b = a->blocks;
+    while( b ) {
+        arena_block_t* next = b->next;
+        free( b );
+        b                   = next;
+    }
+    free( a );
+}
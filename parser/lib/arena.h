@@ -0,0 +1,108 @@
+#ifndef __TOMLIBC_ARENA_H__
+#define __TOMLIBC_ARENA_H__
+
+#include <stddef.h>
+
+/*
+    Allocations are aligned to `ARENA_ALIGN` bytes. The
+    first block of an arena holds `ARENA_MIN_BLOCK` bytes
+    and every new block twice as much as the one before,
+    up to `ARENA_MAX_BLOCK`. Allocations of more than a
+    quarter of that get a block of their own.
+*/
+#define ARENA_ALIGN     16
+#define ARENA_MIN_BLOCK 4096        // 2^12
+#define ARENA_MAX_BLOCK 1048576     // 2^20
+
+typedef struct arena_block arena_block_t;
+struct
+arena_block {
+    arena_block_t* next;
+    size_t         size;
+};
+
+/*
+    Struct `arena` is a bump allocator. Memory is handed
+    out from the newest block and is only given back all
+    at once by `delete_arena`, so a whole document is
+    freed with one `free` per block.
+*/
+typedef struct arena arena_t;
+struct
+arena {
+    /* the blocks, the one allocated from first */
+    arena_block_t* blocks;
+    /* unused part of the first block */
+    char*          next;
+    char*          end;
+    /* size of the next block */
+    size_t         grow;
+};
+
+/*
+    Variable `current_arena` is the arena that the keys
+    and values created on the calling thread are allocated
+    from. Function `use_arena` makes `a` the current arena
+    and returns the previous one, to be restored once the
+    document is built.
+*/
+extern _Thread_local arena_t* current_arena;
+
+arena_t*
+use_arena( arena_t* a );
+
+arena_t*
+new_arena( void );
+
+/*
+    Function `arena_alloc` returns `size` bytes of zeroed
+    memory from `a`, or NULL if no block could be
+    allocated.
+*/
+void*
+arena_alloc(
+    arena_t* a,
+    size_t   size
+);
+
+/*
+    Function `arena_strndup` copies `len` chars of `s`
+    into `a`, followed by a NUL.
+*/
+char*
+arena_strndup(
+    arena_t*    a,
+    const char* s,
+    size_t      len
+);
+
+/*
+    Function `arena_realloc` is the `realloc` of memory
+    that came from `arena_realloc` itself, which keeps
+    the size in front of it. The memory grows in place if
+    it was the last allocation of the block, otherwise it
+    is copied and the old copy stays until the arena is
+    deleted. A NULL `p` allocates new memory.
+*/
+void*
+arena_realloc(
+    arena_t* a,
+    void*    p,
+    size_t   size
+);
+
+/*
+    Function `arena_adopt` moves the blocks of `other`
+    into `a` and deletes `other`, so memory allocated from
+    either one lives as long as `a`.
+*/
+void
+arena_adopt(
+    arena_t* a,
+    arena_t* other
+);
+
+void
+delete_arena( arena_t* a );
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __TOMLIBC_DECIMAL_H__
+#define __TOMLIBC_DECIMAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+    Struct `decimal` is the number `mantissa * 10^exponent`,
+    as read from the digits of a float. When the digits did
+    not all fit in the mantissa, `truncated` is set and the
+    number lies between `mantissa` and `mantissa+1` times
+    `10^exponent`.
+*/
+typedef struct decimal decimal_t;
+struct
+decimal {
+    uint64_t mantissa;
+    int64_t  exponent;
+    bool     negative;
+    bool     truncated;
+};
+
+/*
+    Function `decimal_to_double` rounds `dec` to the nearest
+    double, with ties to even, and stores it in `d`. Small
+    numbers are multiplied out exactly, all others go
+    through the Eisel-Lemire algorithm with a table of
+    128-bit powers of five. It returns false only if `dec`
+    is truncated and both of its bounds round differently,
+    in which case the digits have to be converted in full.
+*/
+bool
+decimal_to_double(
+    const decimal_t* dec,
+    double*          d
+);
+
+#endif
@@ -0,0 +1,450 @@
+#include "indexer.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define INDEXER_X86
+#endif
+
+/*
+    Enum `index_state` is what the characters being
+    walked over belong to, which decides the structural
+    characters that are recorded.
+*/
+typedef enum index_state index_state_t;
+enum
+index_state {
+    INDEX_KEYVAL,
+    INDEX_COMMENT,
+    INDEX_BASICSTRING,
+    INDEX_LITERALSTRING,
+    INDEX_MLBASICSTRING,
+    INDEX_MLLITERALSTRING,
+};
+
+/*
+    Every character that can change the state or has to
+    be recorded in some state is a candidate. Candidates
+    are classified for a whole block at once, and only
+    those are then looked at one by one.
+*/
+static inline bool
+is_candidate( uint8_t c ) {
+    switch( c ) {
+        case '"': case '\'': case '\\': case '#':
+        case '[': case ']':  case '{':  case '}':
+        case '=': case ',':  case '.':
+            return true;
+        default:
+            return ( c<0x20 && c!='\t' ) || c==0x7F;
+    }
+}
+
+#if !( defined( INDEXER_X86 ) && defined( __SSE2__ ) )
+static uint64_t
+classify_scalar( const uint8_t* block ) {
+    uint64_t mask   = 0;
+    for( int i=0; i<64; i++ ) {
+        if( is_candidate( block[ i ] ) ) {
+            mask   |= ( uint64_t )1<<i;
+        }
+    }
+    return mask;
+}
+#endif
+
+#if defined( INDEXER_X86 ) && defined( __SSE2__ )
+#define MATCH_SSE2( V, C ) _mm_cmpeq_epi8( V, _mm_set1_epi8( C ) )
+
+static uint64_t
+classify_sse2( const uint8_t* block ) {
+    uint64_t mask   = 0;
+    for( int i=0; i<4; i++ ) {
+        __m128i v   = _mm_loadu_si128( ( const __m128i* )( block+16*i ) );
+        __m128i m   = _mm_or_si128( MATCH_SSE2( v, '"' ), MATCH_SSE2( v, '\'' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '\\' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '#' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '[' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, ']' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '{' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '}' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '=' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, ',' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, '.' ) );
+        m           = _mm_or_si128( m, MATCH_SSE2( v, 0x7F ) );
+        // control characters are the ones left unchanged
+        // by an unsigned max with 0x1F, except for tabs
+        __m128i c   = MATCH_SSE2( _mm_max_epu8( v, _mm_set1_epi8( 0x1F ) ), 0x1F );
+        c           = _mm_andnot_si128( MATCH_SSE2( v, '\t' ), c );
+        m           = _mm_or_si128( m, c );
+        mask       |= ( uint64_t )( uint16_t )_mm_movemask_epi8( m )<<( 16*i );
+    }
+    return mask;
+}
+#endif
+
+#ifdef INDEXER_X86
+#define MATCH_AVX2( V, C ) _mm256_cmpeq_epi8( V, _mm256_set1_epi8( C ) )
+
+__attribute__(( target( "avx2" ) ))
+static uint64_t
+classify_avx2( const uint8_t* block ) {
+    uint64_t mask   = 0;
+    for( int i=0; i<2; i++ ) {
+        __m256i v   = _mm256_loadu_si256( ( const __m256i* )( block+32*i ) );
+        __m256i m   = _mm256_or_si256( MATCH_AVX2( v, '"' ), MATCH_AVX2( v, '\'' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '\\' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '#' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '[' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, ']' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '{' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '}' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '=' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, ',' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, '.' ) );
+        m           = _mm256_or_si256( m, MATCH_AVX2( v, 0x7F ) );
+        __m256i c   = MATCH_AVX2( _mm256_max_epu8( v, _mm256_set1_epi8( 0x1F ) ), 0x1F );
+        c           = _mm256_andnot_si256( MATCH_AVX2( v, '\t' ), c );
+        m           = _mm256_or_si256( m, c );
+        mask       |= ( uint64_t )( uint32_t )_mm256_movemask_epi8( m )<<( 32*i );
+    }
+    return mask;
+}
+#endif
+
+typedef uint64_t ( *classify_t )( const uint8_t* block );
+
+static classify_t
+select_classify() {
+#ifdef INDEXER_X86
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        return classify_avx2;
+    }
+#endif
+#if defined( INDEXER_X86 ) && defined( __SSE2__ )
+    return classify_sse2;
+#else
+    return classify_scalar;
+#endif
+}
+
+static inline int
+input_at(
+    const uint8_t* input,
+    size_t         len,
+    size_t         pos
+) {
+    return pos<len ? input[ pos ] : -1;
+}
+
+static bool
+record(
+    indexer_t* idx,
+    size_t     pos
+) {
+    if( idx->count==idx->size ) {
+        size_t    size  = idx->size*2;
+        uint32_t* o     = realloc( idx->offsets, size*sizeof( uint32_t ) );
+        if( !o ) {
+            return false;
+        }
+        idx->offsets    = o;
+        idx->size       = size;
+    }
+    idx->offsets[ idx->count++ ] = ( uint32_t )pos;
+    return true;
+}
+
+/*
+    Struct `index_walk` is the state of a walk over the
+    candidates of an input, shared by `new_indexer` and
+    `split_input`.
+*/
+typedef struct index_walk index_walk_t;
+struct
+index_walk {
+    const uint8_t* in;
+    size_t         len;
+    index_state_t  state;
+    // candidates before `skip` were already handled as
+    // part of a quote run or an escape
+    size_t         skip;
+};
+
+/*
+    Function `index_step` moves the walk `w` past the
+    candidate at `pos`, returning the number of structural
+    characters starting there, which is 2 for both quotes
+    of an empty string.
+*/
+static inline int
+index_step(
+    index_walk_t* w,
+    size_t        pos
+) {
+    const uint8_t* in   = w->in;
+    size_t         len  = w->len;
+    int            c    = in[ pos ];
+    switch( w->state ) {
+        case INDEX_KEYVAL:
+            if( c=='"' || c=='\'' ) {
+                if( input_at( in, len, pos+1 )!=c ) {
+                    w->state    = ( c=='"' ) ? INDEX_BASICSTRING : INDEX_LITERALSTRING;
+                }
+                else if( input_at( in, len, pos+2 )!=c ) {
+                    // empty string
+                    w->skip     = pos+2;
+                    return 2;
+                }
+                else {
+                    w->state    = ( c=='"' ) ? INDEX_MLBASICSTRING : INDEX_MLLITERALSTRING;
+                    w->skip     = pos+3;
+                }
+                return 1;
+            }
+            else if( c=='#' ) {
+                w->state    = INDEX_COMMENT;
+                return 1;
+            }
+            // punctuation and newlines
+            return c=='\n' || ( c>=0x20 && c!='\\' && c!=0x7F );
+        case INDEX_COMMENT:
+            if( c<0x20 || c==0x7F ) {
+                if( c=='\n' ||
+                    ( c=='\r' && input_at( in, len, pos+1 )=='\n' ) ) {
+                    w->state    = INDEX_KEYVAL;
+                }
+                return 1;
+            }
+            return 0;
+        case INDEX_BASICSTRING:
+        case INDEX_LITERALSTRING:
+            if( c=='\\' && w->state==INDEX_BASICSTRING ) {
+                w->skip     = pos+2;
+            }
+            else if( c=='\n' ||
+                     c==( w->state==INDEX_BASICSTRING ? '"' : '\'' ) ) {
+                w->state    = INDEX_KEYVAL;
+                return 1;
+            }
+            return 0;
+        case INDEX_MLBASICSTRING:
+        case INDEX_MLLITERALSTRING: {
+            int quote   = ( w->state==INDEX_MLBASICSTRING ) ? '"' : '\'';
+            int end     = 0;
+            if( c=='\\' && w->state==INDEX_MLBASICSTRING ) {
+                w->skip     = pos+2;
+            }
+            else if( c==quote ) {
+                size_t run  = 1;
+                while( input_at( in, len, pos+run )==quote ) {
+                    run++;
+                }
+                if( run>=3 ) {
+                    w->state    = INDEX_KEYVAL;
+                    end         = 1;
+                }
+                w->skip     = pos+run;
+            }
+            return end;
+        }
+    }
+    return 0;
+}
+
+/*
+    Function `walk_block` classifies the 64 characters of
+    the input starting at `base`, padding the last block
+    with spaces, which are never candidates.
+*/
+static inline uint64_t
+walk_block(
+    index_walk_t* w,
+    classify_t    classify,
+    size_t        base
+) {
+    if( w->len-base>=64 ) {
+        return classify( w->in+base );
+    }
+    uint8_t block[ 64 ];
+    memset( block, ' ', sizeof( block ) );
+    memcpy( block, w->in+base, w->len-base );
+    return classify( block );
+}
+
+indexer_t*
+new_indexer(
+    const char* input,
+    size_t      len
+) {
+    if( len>UINT32_MAX ) {
+        return NULL;
+    }
+    indexer_t* idx      = calloc( 1, sizeof( indexer_t ) );
+    RETURN_IF_FAILED( idx, "could not allocate indexer\n" );
+    idx->len            = len;
+    idx->size           = len/16+16;
+    idx->offsets        = malloc( idx->size*sizeof( uint32_t ) );
+    if( !idx->offsets ) {
+        free( idx );
+        LOG_ERR( "could not allocate indexer\n" );
+        return NULL;
+    }
+    classify_t   classify   = select_classify();
+    index_walk_t w          = { ( const uint8_t* )input, len, INDEX_KEYVAL, 0 };
+    bool         ok         = true;
+    for( size_t base=0; base<len && ok; base+=64 ) {
+        uint64_t mask   = walk_block( &w, classify, base );
+        while( mask && ok ) {
+            size_t pos  = base+__builtin_ctzll( mask );
+            mask       &= mask-1;
+            if( pos<w.skip ) {
+                continue;
+            }
+            int n       = index_step( &w, pos );
+            for( int i=0; i<n && ok; i++ ) {
+                ok      = record( idx, pos+i );
+            }
+        }
+    }
+    if( !ok ) {
+        LOG_ERR( "could not grow indexer\n" );
+        delete_indexer( idx );
+        return NULL;
+    }
+    return idx;
+}
+
+/*
+    A `[` only starts a table header if nothing but
+    whitespace comes before it on its line.
+*/
+static bool
+is_line_start(
+    const uint8_t* in,
+    size_t         pos
+) {
+    while( pos>0 && ( in[ pos-1 ]==' ' || in[ pos-1 ]=='\t' ) ) {
+        pos--;
+    }
+    return pos==0 || in[ pos-1 ]=='\n';
+}
+
+/*
+    Function `header_path` points `path` at the text of
+    the path of the table header at `pos`, without the
+    white space around it, and returns its length. Keys
+    are not decoded, the text is only compared with the
+    text of other headers.
+*/
+static size_t
+header_path(
+    const uint8_t*  in,
+    size_t          len,
+    size_t          pos,
+    const uint8_t** path
+) {
+    size_t start    = pos+1;
+    if( input_at( in, len, start )=='[' ) {
+        start++;
+    }
+    while( start<len && ( in[ start ]==' ' || in[ start ]=='\t' ) ) {
+        start++;
+    }
+    size_t end      = start;
+    while( end<len && in[ end ]!=']' && in[ end ]!='\n' ) {
+        end++;
+    }
+    while( end>start && ( in[ end-1 ]==' ' || in[ end-1 ]=='\t' ) ) {
+        end--;
+    }
+    *path           = in+start;
+    return end-start;
+}
+
+size_t
+split_input(
+    const char* input,
+    size_t      len,
+    size_t      target,
+    size_t*     splits,
+    size_t      max
+) {
+    classify_t     classify = select_classify();
+    index_walk_t   w        = { ( const uint8_t* )input, len, INDEX_KEYVAL, 0 };
+    size_t         n        = 0;
+    size_t         last     = 0;
+    // brackets and braces left open by the values, the
+    // ones of table headers are always closed on their line
+    size_t         depth    = 0;
+    // path of the array of tables whose last entry the
+    // headers after it can still add tables to
+    const uint8_t* entry    = NULL;
+    size_t         entry_len    = 0;
+    for( size_t base=0; base<len && n<max; base+=64 ) {
+        uint64_t mask   = walk_block( &w, classify, base );
+        while( mask && n<max ) {
+            size_t pos  = base+__builtin_ctzll( mask );
+            mask       &= mask-1;
+            if( pos<w.skip ) {
+                continue;
+            }
+            bool keyval = w.state==INDEX_KEYVAL;
+            int  c      = w.in[ pos ];
+            if( !index_step( &w, pos ) || !keyval ) {
+                continue;
+            }
+            if( c=='[' && depth==0 && is_line_start( w.in, pos ) ) {
+                const uint8_t* path;
+                size_t         path_len = header_path( w.in, len, pos, &path );
+                // a header inside the entry could not be
+                // parsed without the header of the entry
+                bool           inside   = entry && path_len>entry_len &&
+                                          memcmp( path, entry, entry_len )==0 &&
+                                          path[ entry_len ]=='.';
+                if( !inside ) {
+                    if( pos>0 && pos-last>=target ) {
+                        splits[ n++ ]   = pos;
+                        last            = pos;
+                    }
+                    entry       = input_at( w.in, len, pos+1 )=='[' ? path : NULL;
+                    entry_len   = path_len;
+                }
+            }
+            if( c=='[' || c=='{' ) {
+                depth++;
+            }
+            else if( ( c==']' || c=='}' ) && depth>0 ) {
+                depth--;
+            }
+        }
+    }
+    return n;
+}
+
+size_t
+next_structural(
+    indexer_t* idx,
+    size_t     pos
+) {
+    while( idx->next<idx->count && idx->offsets[ idx->next ]<pos ) {
+        idx->next++;
+    }
+    if( idx->next==idx->count ) {
+        return idx->len;
+    }
+    return idx->offsets[ idx->next ];
+}
+
+void
+delete_indexer( indexer_t* idx ) {
+    if( !idx ) {
+        return;
+    }
+    free( idx->offsets );
+    free( idx );
+}
@@ -0,0 +1,102 @@
+#ifndef __TOMLIBC_INDEXER_H__
+#define __TOMLIBC_INDEXER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Inputs that are fully resident in memory and at
+    least `INDEX_MIN_SIZE` characters long are indexed
+    before they are tokenized. The tokenizer only uses
+    the index to jump over strings and comments, which
+    it scans 16 characters at a time anyway, so the
+    extra pass and its 4 bytes per structural character
+    do not pay off on any input measured so far, and
+    nothing is indexed by default. The tests build with
+    a value of 1 to keep the index working.
+*/
+#ifndef INDEX_MIN_SIZE
+#define INDEX_MIN_SIZE SIZE_MAX
+#endif
+
+/*
+    Struct `indexer` holds the input offsets of every
+    structural character, which are `[]{}=,.#`, newlines
+    and the opening and closing quotes of strings. Quotes
+    and escapes inside strings and everything inside
+    comments are left out, except for characters that
+    end a comment or make it invalid, so the tokenizer
+    can jump from the start of a string or a comment
+    straight to where it ends.
+*/
+typedef struct indexer indexer_t;
+struct
+indexer {
+    /* sorted input offsets of the structural characters */
+    uint32_t* offsets;
+    /* number of offsets */
+    size_t    count;
+    /* allocated number of offsets */
+    size_t    size;
+    /* the first offset not passed by `next_structural` */
+    size_t    next;
+    /* length of the indexed input */
+    size_t    len;
+};
+
+/*
+    Function `new_indexer` scans `len` characters of
+    `input` in blocks of 64, classifying the characters
+    of each block into a bitmask with SIMD instructions
+    when the CPU has them, and then walks the set bits
+    to build the offsets. Inputs longer than 4 GiB are
+    not indexed. Returns NULL if the input could not be
+    indexed.
+*/
+indexer_t*
+new_indexer(
+    const char* input,
+    size_t      len
+);
+
+/*
+    Function `next_structural` returns the offset of
+    the first structural character at or after `pos`,
+    or the length of the input if there is none. The
+    offsets passed are skipped for good, so `pos` must
+    never decrease between calls.
+*/
+size_t
+next_structural(
+    indexer_t* idx,
+    size_t     pos
+);
+
+/*
+    Function `split_input` finds up to `max` table headers
+    of the `len` characters of `input` that are at least
+    `target` characters apart, storing their offsets in
+    `splits`, in the same pass over the input that
+    `new_indexer` makes. A `[` starts a header if it is
+    the first character on its line outside of strings,
+    comments, arrays and inline tables. Headers of tables
+    inside the last entry of an array of tables, like
+    `[a.b]` after `[[a]]`, are never split at, since the
+    part starting there could not be parsed on its own.
+    The input is not validated, so the parts between the
+    splits still have to be parsed to know the splits are
+    right. Returns the number of splits found.
+*/
+size_t
+split_input(
+    const char* input,
+    size_t      len,
+    size_t      target,
+    size_t*     splits,
+    size_t      max
+);
+
+void
+delete_indexer( indexer_t* idx );
+
+#endif
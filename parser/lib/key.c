@@ -2,30 +2,281 @@
 #include "utils.h"
 #include "value.h"
 
-#include "khash.h"
-
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
-toml_key_t*
-new_key( toml_key_type_t type ) {
-    toml_key_t* k   = calloc( 1, sizeof( toml_key_t ) );
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+    Struct `document` keeps the arena of a document in
+    front of its `root` key.
+*/
+typedef struct document document_t;
+struct
+document {
+    arena_t*   arena;
+    toml_key_t root;
+};
+
+static toml_key_t*
+init_key(
+    toml_key_t*     k,
+    toml_key_type_t type
+) {
     k->type         = type;
+    k->id           = "";
+    k->len          = 0;
     k->value        = NULL;
     k->idx          = -1;
-    k->subkeys      = kh_init( str );
-    memset( k->id, 0, TOML_MAX_ID_LENGTH );
+    k->count        = 0;
+    k->entries      = NULL;
+    k->index        = NULL;
     return k;
 }
 
+toml_key_t*
+new_key( toml_key_type_t type ) {
+    return init_key( arena_alloc( current_arena, sizeof( toml_key_t ) ), type );
+}
+
+toml_key_t*
+new_root( void ) {
+    arena_t*    a   = new_arena();
+    document_t* d   = arena_alloc( a, sizeof( document_t ) );
+    if( !d ) {
+        delete_arena( a );
+        return NULL;
+    }
+    d->arena        = a;
+    arena_t*    prev    = use_arena( a );
+    init_key( &d->root, TOML_TABLE );
+    use_arena( prev );
+    d->root.id      = "root";
+    d->root.len     = strlen( "root" );
+    return &d->root;
+}
+
+arena_t*
+root_arena( toml_key_t* root ) {
+    document_t* d   = ( document_t* )( ( char* )root-offsetof( document_t, root ) );
+    return d->arena;
+}
+
+void
+delete_root( toml_key_t* root ) {
+    if( root ) {
+        delete_arena( root_arena( root ) );
+    }
+}
+
+/*
+    Struct `toml_index` finds the subkeys of a large table
+    by hash. It is an open-addressing table of `groups`
+    groups of `GROUP_SIZE` slots, each with a control byte
+    that is `EMPTY` or the top 7 bits of the hash, and the
+    place of its subkey in `entries`. All the control
+    bytes of a group are matched at once, and a group
+    with an `EMPTY` slot ends the search. No more than
+    half of the slots are ever used.
+*/
+#define GROUP_SIZE  16
+#define EMPTY       0x80
+
+struct
+toml_index {
+    size_t    groups;
+    uint8_t*  ctrl;
+    uint32_t* slots;
+};
+
+/*
+    Function `hash_id` is the FNV-1a hash of the `len`
+    chars of `id`, with its bits mixed so that the low
+    ones pick groups as well as the high ones.
+*/
+static uint64_t
+hash_id(
+    const char* id,
+    size_t      len
+) {
+    uint64_t h  = 14695981039346656037ULL;
+    for( size_t i=0; i<len; i++ ) {
+        h      ^= ( unsigned char )id[ i ];
+        h      *= 1099511628211ULL;
+    }
+    h          ^= h>>33;
+    h          *= 0xff51afd7ed558ccdULL;
+    h          ^= h>>33;
+    return h;
+}
+
+/*
+    Function `match_group` returns a bit for each slot of
+    the group at `ctrl` whose control byte is `c`.
+*/
+static unsigned
+match_group(
+    const uint8_t* ctrl,
+    uint8_t        c
+) {
+#ifdef __SSE2__
+    __m128i g   = _mm_loadu_si128( ( const __m128i* )ctrl );
+    return ( unsigned )_mm_movemask_epi8( _mm_cmpeq_epi8( g, _mm_set1_epi8( ( char )c ) ) );
+#else
+    unsigned m  = 0;
+    for( int i=0; i<GROUP_SIZE; i++ ) {
+        if( ctrl[ i ]==c ) {
+            m  |= 1u<<i;
+        }
+    }
+    return m;
+#endif
+}
+
+static void
+index_put(
+    toml_index_t* x,
+    uint64_t      hash,
+    uint32_t      entry
+) {
+    size_t g    = hash&( x->groups-1 );
+    for( ;; ) {
+        unsigned m  = match_group( x->ctrl+g*GROUP_SIZE, EMPTY );
+        if( m ) {
+            size_t i        = g*GROUP_SIZE+__builtin_ctz( m );
+            x->ctrl[ i ]    = ( uint8_t )( hash>>57 );
+            x->slots[ i ]   = entry;
+            return;
+        }
+        g           = ( g+1 )&( x->groups-1 );
+    }
+}
+
+/*
+    Function `new_index` builds an index of the subkeys of
+    `key` that has them fill at most a quarter of its
+    slots, from the hashes kept in `entries`.
+*/
+static toml_index_t*
+new_index( const toml_key_t* key ) {
+    size_t groups   = 1;
+    while( groups*GROUP_SIZE<( size_t )key->count*4 ) {
+        groups     *= 2;
+    }
+    size_t        slots = groups*GROUP_SIZE;
+    toml_index_t* x     = arena_alloc( current_arena, sizeof( toml_index_t )+
+                                       slots*( sizeof( uint8_t )+sizeof( uint32_t ) ) );
+    RETURN_IF_FAILED( x, "could not allocate index\n" );
+    x->groups       = groups;
+    x->slots        = ( uint32_t* )( x+1 );
+    x->ctrl         = ( uint8_t* )( x->slots+slots );
+    memset( x->ctrl, EMPTY, slots );
+    for( int i=0; i<key->count; i++ ) {
+        index_put( x, key->entries[ i ].hash, ( uint32_t )i );
+    }
+    return x;
+}
+
+static bool
+is_entry(
+    const toml_subkey_t* s,
+    uint64_t             hash,
+    const char*          id,
+    size_t               len
+) {
+    return s->hash==hash && s->key->len==len && memcmp( s->key->id, id, len )==0;
+}
+
+toml_key_t*
+find_subkey(
+    const toml_key_t* key,
+    const char*       id,
+    size_t            len
+) {
+    uint64_t h  = hash_id( id, len );
+    if( !key->index ) {
+        for( int i=0; i<key->count; i++ ) {
+            if( is_entry( &key->entries[ i ], h, id, len ) ) {
+                return key->entries[ i ].key;
+            }
+        }
+        return NULL;
+    }
+    const toml_index_t* x   = key->index;
+    size_t              g   = h&( x->groups-1 );
+    for( ;; ) {
+        const uint8_t* ctrl = x->ctrl+g*GROUP_SIZE;
+        for( unsigned m=match_group( ctrl, ( uint8_t )( h>>57 ) ); m; m&=m-1 ) {
+            const toml_subkey_t* s = &key->entries[ x->slots[ g*GROUP_SIZE+__builtin_ctz( m ) ] ];
+            if( is_entry( s, h, id, len ) ) {
+                return s->key;
+            }
+        }
+        if( match_group( ctrl, EMPTY ) ) {
+            return NULL;
+        }
+        g           = ( g+1 )&( x->groups-1 );
+    }
+}
+
 toml_key_t*
 has_subkey(
     toml_key_t* key,
     toml_key_t* subkey
 ) {
-    khiter_t k = kh_get( str, key->subkeys, subkey->id );
-    if( k==kh_end( key->subkeys ) ) return NULL;
-    return kh_value( key->subkeys, k );
+    return find_subkey( key, subkey->id, subkey->len );
+}
+
+toml_key_t*
+next_subkey(
+    const toml_key_t* key,
+    size_t*           it
+) {
+    if( *it<( size_t )key->count ) {
+        return key->entries[ ( *it )++ ].key;
+    }
+    return NULL;
+}
+
+/*
+    Function `put_subkey` appends `subkey` to the subkeys
+    of `key`, which must not have one with the same id
+    yet. The room in `entries` starts at `TOML_SMALL_TABLE`
+    and doubles whenever it is full. Once there are more
+    subkeys than that, the index is kept up to date, and
+    rebuilt larger when half of its slots are used.
+*/
+static toml_key_t*
+put_subkey(
+    toml_key_t* key,
+    toml_key_t* subkey
+) {
+    int n   = key->count;
+    if( n==0 || ( n>=TOML_SMALL_TABLE && ( n&( n-1 ) )==0 ) ) {
+        RETURN_IF_FAILED( n<=INT_MAX/2, "table has too many keys\n" );
+        size_t         room = n ? ( size_t )n*2 : TOML_SMALL_TABLE;
+        toml_subkey_t* e    = arena_realloc( current_arena, key->entries,
+                                              room*sizeof( toml_subkey_t ) );
+        RETURN_IF_FAILED( e, "could not allocate subkeys\n" );
+        key->entries        = e;
+    }
+    toml_subkey_t* s    = &key->entries[ n ];
+    s->hash             = hash_id( subkey->id, subkey->len );
+    s->key              = subkey;
+    key->count++;
+    if( key->count>TOML_SMALL_TABLE ) {
+        if( !key->index || ( size_t )key->count*2>key->index->groups*GROUP_SIZE ) {
+            key->index  = new_index( key );
+            RETURN_IF_FAILED( key->index, "could not index subkeys\n" );
+        }
+        else {
+            index_put( key->index, s->hash, ( uint32_t )n );
+        }
+    }
+    return subkey;
 }
 
 toml_key_t*
@@ -44,36 +295,73 @@ add_subkey(
             return s;
         }
         else {
-            RETURN_IF_FAILED( 0,
-                "failed to add subkey\n"
-                "existing subkey - key: %s type: %d\n"
-                "new subkey: key: %s type: %d\n", 
-                s->id, ( int )( s->type ),
-                subkey->id, ( int )( subkey->type )
-            );
+            LOG_ERR( "failed to add subkey\n"
+                     "existing subkey - key: %s type: %d\n"
+                     "new subkey: key: %s type: %d\n",
+                     s->id, ( int )( s->type ),
+                     subkey->id, ( int )( subkey->type ) );
+            return NULL;
         }
     }
-    if( kh_size( key->subkeys )<TOML_MAX_SUBKEYS ) {
-        if( key->type==TOML_ARRAYTABLE ) {
-            // since an ARRAYTABLE is a list of a map of key-value,
-            // and re-defining an ARRAYTABLE means adding another map
-            // of key-value to the list, we use the `value->arr`
-            // attribute of the key to store each map of key-values
-            toml_key_t* a = add_subkey( key->value->arr[ key->idx ]->data,
-                                        subkey );
-            return a;
-        }
-        else {
-            int ret;
-            khiter_t k = kh_put( str, key->subkeys, subkey->id, &ret );
-            kh_value( key->subkeys, k ) = subkey;
-            return subkey;
+    if( key->type==TOML_ARRAYTABLE ) {
+        // since an ARRAYTABLE is a list of a map of key-value,
+        // and re-defining an ARRAYTABLE means adding another map
+        // of key-value to the list, we use the `value->arr`
+        // attribute of the key to store each map of key-values
+        toml_key_t* a = add_subkey( key->value->arr[ key->idx ]->data,
+                                    subkey );
+        return a;
+    }
+    return put_subkey( key, subkey );
+}
+
+toml_key_t*
+merge_subkey(
+    toml_key_t* key,
+    toml_key_t* subkey
+) {
+    if( key->type==TOML_ARRAYTABLE ) {
+        // like `add_subkey`, keys go into the last entry
+        return merge_subkey( key->value->arr[ key->idx ]->data, subkey );
+    }
+    toml_key_t* s = has_subkey( key, subkey );
+    if( !s ) {
+        return add_subkey( key, subkey );
+    }
+    if( !compatible_keys( s->type, subkey->type ) ) {
+        LOG_ERR( "failed to merge subkey\n"
+                 "existing subkey - key: %s type: %d\n"
+                 "new subkey: key: %s type: %d\n",
+                 s->id, ( int )( s->type ),
+                 subkey->id, ( int )( subkey->type ) );
+        return NULL;
+    }
+    if( subkey->type==TOML_TABLELEAF ) {
+        s->type = TOML_TABLELEAF;
+    }
+    if( subkey->type==TOML_ARRAYTABLE ) {
+        // the entries of `subkey` come after the ones of `s`
+        for( int i=0; i<subkey->value->len; i++ ) {
+            RETURN_IF_FAILED( push_value( s->value, subkey->value->arr[ i ] ),
+                              "could not merge entries of %s\n", s->id );
         }
+        s->idx  = s->value->len-1;
     }
-    else {
-        LOG_ERR( "buffer overflow\n" );
+    return merge_subkeys( s, subkey );
+}
+
+toml_key_t*
+merge_subkeys(
+    toml_key_t* key,
+    toml_key_t* from
+) {
+    size_t      it  = 0;
+    toml_key_t* s;
+    while( ( s=next_subkey( from, &it ) ) ) {
+        RETURN_IF_FAILED( merge_subkey( key, s ),
+                          "failed to merge subkeys of %s\n", key->id );
     }
-    return NULL;
+    return key;
 }
 
 bool
@@ -116,13 +404,3 @@ compatible_keys(
     }
     return false;
 }
-
-void
-delete_key( toml_key_t* key ) {
-    if( !key ) return;
-    kh_destroy( str, key->subkeys );
-    if( key->value ) {
-        delete_value( key->value );
-    }
-    free( key );
-}
@@ -4,30 +4,40 @@
 #include "models.h"
 
 /*
-    Function `new_key` allocates memory to create
-    a new key/node in the AST. It takes the key type
-    as an argument and initializes everything else
-    to NULL and idx to 0. Returns a pointer to the
-    newly allocated key.
+    Function `new_key` allocates memory from the current
+    arena to create a new key/node in the AST. It takes
+    the key type as an argument and initializes everything
+    else to NULL, the `id` to an empty string and idx to
+    -1. Returns a pointer to the newly allocated key.
 */
 toml_key_t*
 new_key( toml_key_type_t type );
 
 /*
-    Function `delete_key` frees up all the memory allocated
-    by this key. It first recursively frees up all the
-    memory allocated by the keys in `children` if any. Then
-    it frees up all the memory allocated by `value` if any.
-    Finally, it frees up the memory allocated by itself.
+    Function `new_root` creates the arena of a new
+    document and its `root` key, allocated from it. The
+    keys and values of the document are allocated from
+    `root_arena` while it is the current arena, and are
+    only freed all at once by `delete_root`, so keys that
+    are left out of the tree are never freed on their own.
+    Returns NULL if the arena could not be allocated.
 */
+toml_key_t*
+new_root( void );
+
+arena_t*
+root_arena( toml_key_t* root );
+
 void
-delete_key( toml_key_t* key );
+delete_root( toml_key_t* root );
 
 /*
     Function `has_subkey` checks if a `key` has a `subkey`
     in its list of `children` by iterating through it
     and matching against the `id`. Returns a pointer
     to the key if it exists, else returns NULL.
+    Function `find_subkey` does the same for an `id` of
+    `len` chars.
 */
 toml_key_t* 
 has_subkey(
@@ -35,6 +45,24 @@ has_subkey(
     toml_key_t* subkey
 );
 
+toml_key_t*
+find_subkey(
+    const toml_key_t* key,
+    const char*       id,
+    size_t            len
+);
+
+/*
+    Function `next_subkey` returns the subkeys of `key`
+    in the order they were added, starting with `*it` set
+    to 0, and NULL once they have all been returned.
+*/
+toml_key_t*
+next_subkey(
+    const toml_key_t* key,
+    size_t*           it
+);
+
 /*
     Function `add_subkey` tries to add `subkey` in the
     list of `children` of `key`. There are checks to do
@@ -44,7 +72,9 @@ has_subkey(
     the old "key". If yes, or if the `subkey` did not exist
     in the first place, a pointer to the existing or newly
     added subkey is returned respectively. Otherwise, it
-    returns a NULL pointer on failure or buffer overflow.
+    returns a NULL pointer on failure.
+    The `subkey` is dropped if it is not the key that was
+    returned.
 */
 toml_key_t*
 add_subkey(
@@ -52,6 +82,30 @@ add_subkey(
     toml_key_t* subkey
 );
 
+/*
+    Function `merge_subkey` adds `subkey` together with
+    its own `subkeys` to `key`. If `key` already has a key
+    with the same `id`, the two are checked the same way
+    `add_subkey` does and their `subkeys` are merged, with
+    the entries of an `ARRAYTABLE` following the existing
+    ones. Returns the key `subkey` was merged into, or
+    NULL on failure. Function `merge_subkeys` merges all
+    the `subkeys` of `from` into `key` that way. The keys
+    stay in the arena of `from`, which has to live as long
+    as the one of `key`. Returns `key`, or NULL on failure.
+*/
+toml_key_t*
+merge_subkey(
+    toml_key_t* key,
+    toml_key_t* subkey
+);
+
+toml_key_t*
+merge_subkeys(
+    toml_key_t* key,
+    toml_key_t* from
+);
+
 /*
     Function `compatible_keys` is used to decide if the
     re-definition of a key is acceptable by TOML specs.
@@ -1,16 +1,15 @@
 #ifndef __TOMLIBC_MODELS_H__
 #define __TOMLIBC_MODELS_H__
 
-#include "khash.h"
+#include "arena.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
-#define TOML_MAX_DATE_FORMAT    64
-#define TOML_MAX_ID_LENGTH      256
-#define TOML_MAX_STRING_LENGTH  4096
-
-#define TOML_MAX_SUBKEYS        131072  // 2^17
-#define TOML_MAX_ARRAY_LENGTH   131072  // 2^17
+#define TOML_MAX_KEY_DEPTH      64
+#define TOML_SMALL_TABLE        8
 
 /*
     Enum `toml_value_type` represents the set of value
@@ -32,25 +31,68 @@ toml_value_type {
     TOML_INLINETABLE,
 };
 
+/*
+    Struct `toml_datetime` holds any of the four datetime
+    types in 16 bytes, worked out once when it is parsed.
+    `epoch` counts seconds since 1970-01-01T00:00:00Z, so
+    offset datetimes compare and sort by it directly.
+    Local datetimes and dates count as if they were in
+    UTC, and local times count from midnight.
+*/
+typedef struct toml_datetime toml_datetime_t;
+struct
+toml_datetime {
+    int64_t             epoch;
+    /* the fractional seconds, truncated to nanoseconds,
+       and the number of digits they were written with */
+    int32_t             nanos;
+    /* minutes east of UTC, for `DATETIME` values */
+    int16_t             offset;
+    uint8_t             digits;
+    /* `DATETIME`, `DATETIMELOCAL`, `DATELOCAL` or
+       `TIMELOCAL`, as a `toml_value_type_t` */
+    uint8_t             kind;
+};
+
 /*
     Struct `toml_value` holds the various attributes
-    associated with a TOML value.
+    associated with a TOML value, in 24 bytes. Scalars
+    are stored in the value itself, only strings, arrays
+    and inline tables point to more memory.
 */
 typedef struct toml_value toml_value_t;
 struct
 toml_value {
     /* the type of TOML value */
     toml_value_type_t   type;
-    /* used for storing `ARRAY` type values */
-    toml_value_t**      arr;
-    int                 len;
-    /* used for storing non-`ARRAY` type values */
-    void*               data;
-    /* used for printing numeric values */
-    int                 precision;
+    /* used for printing `FLOAT` values */
+    uint16_t            precision;
     bool                scientific;
-    /* used for printing datetime values */
-    char                format[ TOML_MAX_DATE_FORMAT ];
+    union {
+        struct {
+            union {
+                /* `ARRAY` values, with room for `size`
+                   values and holding `len` */
+                toml_value_t**  arr;
+                /* the chars of a `STRING`, `len` long and
+                   followed by a NUL, or the key of an
+                   `INLINETABLE` */
+                void*           data;
+            };
+            int                 len;
+            int                 size;
+        };
+        /* `INT` values, and a copy for `toml_get_int`
+           if they fit in an `int` */
+        struct {
+            int64_t             integer;
+            int                 narrow;
+        };
+        double                  number;
+        bool                    boolean;
+        /* any of the datetime types */
+        toml_datetime_t         datetime;
+    };
 };
 
 /*
@@ -79,19 +121,107 @@ toml_key_type {
     if they were defined as TOML keys or tables.
 */
 typedef struct toml_key toml_key_t;
-KHASH_MAP_INIT_STR( str, toml_key_t* )
+
+/*
+    Struct `toml_subkey` is an entry of the subkeys of a
+    table. The `hash` of the id of `key` is kept next to
+    it, so most mismatches are found without comparing
+    ids, and an index can be rebuilt without hashing the
+    ids again. The index itself is private to `key.c`.
+*/
+typedef struct toml_subkey toml_subkey_t;
+struct
+toml_subkey {
+    uint64_t    hash;
+    toml_key_t* key;
+};
+
+typedef struct toml_index toml_index_t;
+
 struct
 toml_key {
     /* key type as described above */
     toml_key_type_t type;
-    /* identifier */
-    char            id[ TOML_MAX_ID_LENGTH ];
-    /* map of subkeys */
-    khash_t( str )* subkeys;
+    /* number of subkeys */
+    int             count;
+    /* identifier, `len` chars long, allocated along
+       with the key */
+    const char*     id;
+    size_t          len;
+    /* subkeys in the order they were added, allocated
+       along with the first one, with an `index` to find
+       them by hash once there are more than
+       `TOML_SMALL_TABLE` */
+    toml_subkey_t*  entries;
+    toml_index_t*   index;
     /* value associated with this key */
     toml_value_t*   value;
     /* used for indexing ARRAYTABLES */
     int             idx;
 };
 
+/*
+    Enum `toml_event_type` represents the events reported
+    by the event parser, in the order they appear in the
+    input. Arrays and inline tables report their values
+    between a `BEGIN` and an `END` event.
+*/
+typedef enum toml_event_type toml_event_type_t;
+enum
+toml_event_type {
+    /* `[a.b]` */
+    TOML_EVENT_TABLE,
+    /* `[[a.b]]` */
+    TOML_EVENT_ARRAYTABLE,
+    /* `a.b =`, followed by its value */
+    TOML_EVENT_KEY,
+    /* a string, number, bool or datetime */
+    TOML_EVENT_VALUE,
+    TOML_EVENT_ARRAY_BEGIN,
+    TOML_EVENT_ARRAY_END,
+    TOML_EVENT_INLINETABLE_BEGIN,
+    TOML_EVENT_INLINETABLE_END,
+};
+
+/*
+    Struct `toml_event` describes a single event. Nothing
+    in it is allocated, so everything it points to is
+    only valid until the handler returns.
+*/
+typedef struct toml_event toml_event_t;
+struct
+toml_event {
+    toml_event_type_t   type;
+    /* the parts of the dotted key of a `TABLE`,
+       `ARRAYTABLE` or `KEY`, keys in inline tables
+       are relative to the inline table */
+    const char* const*  path;
+    int                 depth;
+    /* the type of a `VALUE` */
+    toml_value_type_t   value;
+    /* used for `STRING` values, strings without escapes
+       point straight into the input */
+    const char*         string;
+    size_t              len;
+    /* used for `INT` and `FLOAT` values, an `INT` is
+       also held in full in `integer` */
+    double              number;
+    int64_t             integer;
+    bool                boolean;
+    int                 precision;
+    bool                scientific;
+    /* used for datetime values */
+    const toml_datetime_t* datetime;
+};
+
+/*
+    Handlers of type `toml_event_handler_t` are called
+    with every event and the `data` they were registered
+    with. Returning false stops the parser.
+*/
+typedef bool ( *toml_event_handler_t )(
+    const toml_event_t* event,
+    void*               data
+);
+
 #endif
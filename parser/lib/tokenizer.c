@@ -3,85 +3,576 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static void
+init_tokenizer(
+    tokenizer_t* tok,
+    char*        input
+) {
+    tok->input          = input;
+    tok->file           = NULL;
+    tok->stream         = NULL;
+    tok->offset         = 0;
+    tok->len            = 0;
+    tok->cursor         = 0;
+    tok->mapped         = false;
+    tok->eof            = true;
+    tok->index          = NULL;
+    tok->indexing       = true;
+    tok->released       = 0;
+    tok->token.type     = TOKEN_EOF;
+    tok->token.start    = 0;
+    tok->token.len      = 0;
+    tok->error          = NULL;
+    tok->newline        = true;
+    tok->lines          = 0;
+    tok->line_start     = 0;
+}
 
 tokenizer_t*
 new_tokenizer( char* input ) {
     tokenizer_t* tok    = calloc( 1, sizeof( tokenizer_t ) );
-    tok->input          = input;
-    tok->cursor         = 0;
-    tok->token          = '\0';
-    tok->prev           = '\0';
-    tok->prev_prev      = '\0';
-    tok->line           = 0;
-    tok->col            = 0;
-    tok->has_token      = true;
-    memset( tok->lines, 0, MAX_NUM_LINES );
+    tok->window         = NULL;
+    tok->size           = 0;
+    init_tokenizer( tok, input );
     return tok;
 }
 
-int
-next_token( tokenizer_t* tok ) {
-    tok->prev_prev  = tok->prev;
-    tok->prev       = tok->token;
-    if( tok->has_token || tok->cursor==0 ) {
-        tok->token      = tok->stream[ tok->cursor++ ];
-        // if we parsed some non-whitespace character since we saw
-        // the newline, then we aren't on a newline anymore
-        if( tok->newline && tok->prev && tok->prev!=' ' &&
-            tok->prev!='\t' && tok->prev!='\n'
-        ) {
-            tok->newline = false;
-        }
-        if( tok->token=='\n' ) {
-            tok->newline = true;
-        }
-        if( tok->prev=='\n' ) {
-            if( tok->line<MAX_NUM_LINES ) {
-                tok->lines[ tok->line ] = tok->col;
+static bool
+refill_window( tokenizer_t* tok ) {
+    if( tok->eof ) {
+        return false;
+    }
+    // everything from the start of the token being read
+    // is kept, the data before it can be dropped
+    size_t from     = tok->token.start;
+    size_t keep     = tok->len-from;
+    // remember the newlines in the data we are dropping
+    // so that `get_position` can still count from them
+    const char* end = tok->window+( from-tok->offset );
+    for( const char* c=tok->window;
+         ( c=memchr( c, '\n', end-c ) )!=NULL;
+         c++ ) {
+        tok->lines++;
+        tok->line_start = tok->offset+( c-tok->window )+1;
+    }
+    memmove( tok->window, end, keep );
+    tok->offset     = from;
+    if( keep==tok->size ) {
+        // a single token does not fit in the window
+        char* w     = realloc( tok->window, tok->size*2 );
+        if( !w ) {
+            LOG_ERR( "could not grow input window\n" );
+            tok->eof    = true;
+            return false;
+        }
+        tok->window = w;
+        tok->stream = w;
+        tok->size  *= 2;
+    }
+    size_t r        = fread( tok->window+keep, 1, tok->size-keep, tok->file );
+    if( r==0 ) {
+        if( ferror( tok->file ) ) {
+            LOG_ERR( "could not read input\n" );
+        }
+        tok->eof    = true;
+    }
+    tok->len        = from+keep+r;
+    return r>0;
+}
+
+static inline int
+char_at(
+    tokenizer_t* tok,
+    size_t       pos
+) {
+    while( pos>=tok->len ) {
+        if( !refill_window( tok ) ) {
+            return EOF;
+        }
+    }
+    return ( unsigned char )tok->stream[ pos-tok->offset ];
+}
+
+/*
+    Functions `span_blank` and `span_comment` return the
+    number of characters at the start of the `n` characters
+    of `s` that are spaces or tabs, or that are allowed in
+    a comment. They look at 16 characters at a time where
+    SSE2 is available.
+*/
+static size_t
+span_blank(
+    const char* s,
+    size_t      n
+) {
+    size_t i    = 0;
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8( ' ' );
+    const __m128i tab   = _mm_set1_epi8( '\t' );
+    for( ; i+16<=n; i+=16 ) {
+        __m128i v   = _mm_loadu_si128( ( const __m128i* )( s+i ) );
+        __m128i m   = _mm_or_si128( _mm_cmpeq_epi8( v, space ),
+                                    _mm_cmpeq_epi8( v, tab ) );
+        unsigned other  = ~( unsigned )_mm_movemask_epi8( m ) & 0xFFFF;
+        if( other ) {
+            return i+__builtin_ctz( other );
+        }
+    }
+#endif
+    while( i<n && ( s[ i ]==' ' || s[ i ]=='\t' ) ) {
+        i++;
+    }
+    return i;
+}
+
+static size_t
+span_comment(
+    const char* s,
+    size_t      n
+) {
+    size_t i    = 0;
+#ifdef __SSE2__
+    const __m128i ctrl  = _mm_set1_epi8( 0x1F );
+    const __m128i del   = _mm_set1_epi8( 0x7F );
+    const __m128i tab   = _mm_set1_epi8( '\t' );
+    for( ; i+16<=n; i+=16 ) {
+        __m128i v   = _mm_loadu_si128( ( const __m128i* )( s+i ) );
+        // control characters are left unchanged by an
+        // unsigned max with 0x1F
+        __m128i m   = _mm_cmpeq_epi8( _mm_max_epu8( v, ctrl ), ctrl );
+        m           = _mm_andnot_si128( _mm_cmpeq_epi8( v, tab ), m );
+        m           = _mm_or_si128( m, _mm_cmpeq_epi8( v, del ) );
+        unsigned bad    = ( unsigned )_mm_movemask_epi8( m );
+        if( bad ) {
+            return i+__builtin_ctz( bad );
+        }
+    }
+#endif
+    for( ; i<n; i++ ) {
+        unsigned char c = s[ i ];
+        if( ( c<0x20 && c!='\t' ) || c==0x7F ) {
+            break;
+        }
+    }
+    return i;
+}
+
+/*
+    Functions `span_basic` and `span_literal` return the
+    number of characters at the start of the `n` characters
+    of `s` that cannot end a basic or a literal string,
+    which are all but quotes, newlines and for basic
+    strings backslashes.
+*/
+static size_t
+span_string(
+    const char* s,
+    size_t      n,
+    char        quote,
+    char        escape
+) {
+    size_t i    = 0;
+#ifdef __SSE2__
+    const __m128i q     = _mm_set1_epi8( quote );
+    const __m128i e     = _mm_set1_epi8( escape );
+    const __m128i nl    = _mm_set1_epi8( '\n' );
+    for( ; i+16<=n; i+=16 ) {
+        __m128i v   = _mm_loadu_si128( ( const __m128i* )( s+i ) );
+        __m128i m   = _mm_or_si128( _mm_cmpeq_epi8( v, q ),
+                                    _mm_cmpeq_epi8( v, e ) );
+        m           = _mm_or_si128( m, _mm_cmpeq_epi8( v, nl ) );
+        unsigned stop   = ( unsigned )_mm_movemask_epi8( m );
+        if( stop ) {
+            return i+__builtin_ctz( stop );
+        }
+    }
+#endif
+    while( i<n && s[ i ]!=quote && s[ i ]!=escape && s[ i ]!='\n' ) {
+        i++;
+    }
+    return i;
+}
+
+static size_t
+span_basic(
+    const char* s,
+    size_t      n
+) {
+    return span_string( s, n, '"', '\\' );
+}
+
+static size_t
+span_literal(
+    const char* s,
+    size_t      n
+) {
+    // literal strings have no escapes
+    return span_string( s, n, '\'', '\n' );
+}
+
+/*
+    Function `skip_span` moves `pos` past every character
+    accepted by `span`, refilling the window as needed,
+    and returns the offset of the first one it rejects.
+*/
+static size_t
+skip_span(
+    tokenizer_t* tok,
+    size_t       pos,
+    size_t       ( *span )( const char*, size_t )
+) {
+    while( true ) {
+        while( pos>=tok->len ) {
+            if( !refill_window( tok ) ) {
+                return pos;
             }
-            tok->line++;
-            tok->col        = 0;
+        }
+        size_t n    = tok->len-pos;
+        size_t k    = span( tok->stream+( pos-tok->offset ), n );
+        pos        += k;
+        if( k<n ) {
+            return pos;
+        }
+    }
+}
+
+static inline bool
+is_bare_char( int c ) {
+    return ( ( c>='A' && c<='Z' ) ||
+             ( c>='a' && c<='z' ) ||
+             ( c>='0' && c<='9' ) ||
+             c=='_' || c=='-' );
+}
+
+static inline bool
+is_value_char( int c ) {
+    return ( is_bare_char( c ) ||
+             c=='+' || c=='.' || c==':' );
+}
+
+static inline bool
+is_digit_char( int c ) {
+    return ( c>='0' && c<='9' );
+}
+
+static token_type_t
+lex_invalid(
+    tokenizer_t* tok,
+    const char*  error
+) {
+    tok->error  = error;
+    return TOKEN_INVALID;
+}
+
+static token_type_t
+lex_comment(
+    tokenizer_t* tok,
+    size_t*      p
+) {
+    size_t i    = *p+1;
+    while( true ) {
+        // jump to the first control character
+        if( tok->index ) {
+            i   = next_structural( tok->index, i );
         }
         else {
-            tok->col++;
+            i   = skip_span( tok, i, span_comment );
+        }
+        int c   = char_at( tok, i );
+        if( c==EOF || c=='\n' ) {
+            break;
+        }
+        if( c=='\r' && char_at( tok, i+1 )=='\n' ) {
+            break;
+        }
+        if( ( c<0x20 && c!='\t' ) || c==0x7F ) {
+            *p  = i+1;
+            return lex_invalid( tok, "control characters are not allowed in comments\n" );
+        }
+        i++;
+    }
+    *p          = i;
+    return TOKEN_COMMENT;
+}
+
+static token_type_t
+lex_string(
+    tokenizer_t* tok,
+    size_t*      p,
+    int          quote
+) {
+    bool   basic    = ( quote=='"' );
+    bool   multi    = false;
+    size_t start    = *p;
+    size_t i        = start+1;
+    if( char_at( tok, i )==quote ) {
+        if( char_at( tok, i+1 )!=quote ) {
+            // empty string
+            tok->token.start    = i;
+            tok->token.len      = 0;
+            *p      = i+1;
+            return basic ? TOKEN_BASICSTRING : TOKEN_LITERALSTRING;
+        }
+        multi       = true;
+        i          += 2;
+    }
+    size_t body     = i;
+    while( true ) {
+        // jump to the closing quotes or the newline
+        if( tok->index ) {
+            i       = next_structural( tok->index, i );
+        }
+        else {
+            i       = skip_span( tok, i, basic ? span_basic : span_literal );
+        }
+        int c       = char_at( tok, i );
+        if( c==EOF ) {
+            break;
         }
-        if( tok->token==EOF ) {
-            tok->token      = '\0';
-            tok->has_token  = false;
+        else if( c=='\n' && !multi ) {
+            tok->token.len  = i-start;
+            *p      = i;
+            return lex_invalid( tok, "newline before end of string\n" );
         }
-        return 1;
+        else if( c=='\\' && basic ) {
+            // the escaped character can never end the string
+            i      += 2;
+        }
+        else if( c==quote ) {
+            size_t run  = 1;
+            while( multi && char_at( tok, i+run )==quote ) {
+                run++;
+            }
+            if( !multi || run>=3 ) {
+                *p  = i+run;
+                // up to 2 quotes right before the closing
+                // delimiter are part of the string
+                if( run>5 ) {
+                    tok->token.len  = *p-start;
+                    return lex_invalid( tok, "too many quotes at end of string\n" );
+                }
+                tok->token.start    = body;
+                tok->token.len      = i+run-( multi ? 3 : 1 )-body;
+                if( multi ) {
+                    return basic ? TOKEN_MLBASICSTRING : TOKEN_MLLITERALSTRING;
+                }
+                return basic ? TOKEN_BASICSTRING : TOKEN_LITERALSTRING;
+            }
+            i      += run;
+        }
+        else {
+            i++;
+        }
+    }
+    tok->token.len  = i-start;
+    *p              = i;
+    return lex_invalid( tok, "unterminated string\n" );
+}
+
+int
+next_token( tokenizer_t* tok ) {
+    size_t start        = tok->cursor;
+    size_t p            = start;
+    token_type_t type;
+    tok->token.start    = start;
+    tok->token.len      = 0;
+    tok->error          = NULL;
+    int c               = char_at( tok, p );
+    switch( c ) {
+        case EOF:
+            type        = TOKEN_EOF;
+            break;
+        case ' ':
+        case '\t':
+            p           = skip_span( tok, p+1, span_blank );
+            type        = TOKEN_WHITESPACE;
+            break;
+        case '\n':
+            p++;
+            type        = TOKEN_NEWLINE;
+            break;
+        case '\r':
+            if( char_at( tok, p+1 )=='\n' ) {
+                p      += 2;
+                type    = TOKEN_NEWLINE;
+            }
+            else {
+                p++;
+                type    = lex_invalid( tok, "carriage return without a newline\n" );
+            }
+            break;
+        case '#':
+            type        = lex_comment( tok, &p );
+            break;
+        case '"':
+        case '\'':
+            // strings set their own span
+            tok->token.type     = lex_string( tok, &p, c );
+            tok->cursor         = p;
+            return 1;
+        case '.': p++; type = TOKEN_DOT;      break;
+        case '=': p++; type = TOKEN_EQUAL;    break;
+        case ',': p++; type = TOKEN_COMMA;    break;
+        case '[': p++; type = TOKEN_LBRACKET; break;
+        case ']': p++; type = TOKEN_RBRACKET; break;
+        case '{': p++; type = TOKEN_LBRACE;   break;
+        case '}': p++; type = TOKEN_RBRACE;   break;
+        default:
+            if( is_bare_char( c ) ) {
+                do {
+                    c   = char_at( tok, ++p );
+                } while( is_bare_char( c ) );
+                type    = TOKEN_BAREKEY;
+            }
+            else {
+                p++;
+                type    = lex_invalid( tok, "unexpected character\n" );
+            }
+            break;
     }
-    return 0;
+    tok->token.type     = type;
+    tok->token.len      = p-start;
+    tok->cursor         = p;
+    return type!=TOKEN_EOF;
+}
+
+int
+peek(
+    tokenizer_t* tok,
+    size_t       n
+) {
+    return char_at( tok, tok->token.start+n );
 }
 
 void
-backtrack(
-    tokenizer_t*    tok,
-    int             count
-) {
-    int pre_count           = count+2;
-    if( count>0 && tok->cursor>pre_count ) {
-        tok->cursor         -= pre_count;
-        tok->has_token      = true;
-        int col             = tok->col;
-        while( tok->line>=0 && pre_count>col ) {
-            pre_count       -= col;
-            col             = tok->lines[ --tok->line ];
-        }
-        tok->col            = col-pre_count;
-        if( tok->line<0 )   tok->line = 0;
-        if( tok->col<0  )   tok->col  = 0;
-        next_token( tok );
-        next_token( tok );
+lex_value( tokenizer_t* tok ) {
+    token_type_t type   = tok->token.type;
+    if( ( type!=TOKEN_BAREKEY && type!=TOKEN_INVALID && type!=TOKEN_DOT ) ||
+        !is_value_char( peek( tok, 0 ) ) ) {
+        return;
+    }
+    size_t len          = 0;
+    while( is_value_char( peek( tok, len ) ) ) {
+        len++;
+    }
+    // `YYYY-mm-DD HH:MM:SS` can use a space as the delimiter
+    if( len==10 && peek( tok, 4 )=='-' &&
+        peek( tok, len )==' ' && is_digit_char( peek( tok, len+1 ) ) ) {
+        len++;
+        while( is_value_char( peek( tok, len ) ) ) {
+            len++;
+        }
+    }
+    const char* s       = get_text( tok );
+    tok->error          = NULL;
+    if( ( len==4 && memcmp( s, "true",  4 )==0 ) ||
+        ( len==5 && memcmp( s, "false", 5 )==0 ) ) {
+        type            = TOKEN_BOOL;
+    }
+    else if( is_digit_char( s[ 0 ] ) &&
+             ( ( len>=3 && s[ 2 ]==':' ) ||
+               ( len>=5 && s[ 4 ]=='-' && is_digit_char( s[ 1 ] ) &&
+                 is_digit_char( s[ 2 ] ) && is_digit_char( s[ 3 ] ) ) ) ) {
+        type            = TOKEN_DATETIME;
+    }
+    else if( is_digit_char( s[ 0 ] ) || s[ 0 ]=='+' || s[ 0 ]=='-' ||
+             ( len==3 && ( memcmp( s, "inf", 3 )==0 ||
+                           memcmp( s, "nan", 3 )==0 ) ) ) {
+        type            = TOKEN_NUMBER;
     }
     else {
-        LOG_ERR( "not enough characters to backtrack %d\n", count );
+        type            = lex_invalid( tok, "unknown value type\n" );
+    }
+    tok->token.type     = type;
+    tok->token.len      = len;
+    tok->cursor         = tok->token.start+len;
+}
+
+static bool
+stream_input( tokenizer_t* tok ) {
+    // the window of a reset tokenizer is used again
+    if( !tok->window ) {
+        tok->window = malloc( STREAM_WINDOW_SIZE );
+        if( !tok->window ) {
+            LOG_ERR( "could not allocate input window\n" );
+            return false;
+        }
+        tok->size   = STREAM_WINDOW_SIZE;
+    }
+    tok->stream     = tok->window;
+    tok->offset     = 0;
+    tok->len        = 0;
+    tok->mapped     = false;
+    tok->eof        = false;
+    return true;
+}
+
+static bool
+map_input(
+    tokenizer_t* tok,
+    int          fd,
+    size_t       size
+) {
+    void* buffer    = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if( buffer==MAP_FAILED ) {
+        return false;
+    }
+    // the parser reads the input front to back exactly once,
+    // which sequential readahead covers without faulting in
+    // pages that `release_input` would drop again
+    madvise( buffer, size, MADV_SEQUENTIAL );
+    tok->stream     = buffer;
+    tok->len        = size;
+    tok->mapped     = true;
+    return true;
+}
+
+static void
+index_input( tokenizer_t* tok ) {
+    if( tok->indexing && tok->len>=INDEX_MIN_SIZE ) {
+        // without an index the input is still read
+        // correctly, just one character at a time
+        tok->index  = new_indexer( tok->stream, tok->len );
+    }
+}
+
+bool
+load_stream(
+    tokenizer_t* tok,
+    FILE*        stream
+) {
+    if( !stream ) {
+        LOG_ERR( "could not open input stream\n" );
+        return false;
+    }
+    tok->file       = stream;
+    struct stat st;
+    int    fd       = fileno( stream );
+    // only map the stream if stdio has not buffered anything
+    // from it yet, otherwise we would skip over that data.
+    // Files that fit in the window are cheaper to read
+    if( fstat( fd, &st )==0 && S_ISREG( st.st_mode ) &&
+        st.st_size>=STREAM_WINDOW_SIZE &&
+        ftello( stream )==0 && lseek( fd, 0, SEEK_CUR )==0 &&
+        map_input( tok, fd, ( size_t )st.st_size ) ) {
+        index_input( tok );
+        return true;
     }
+    // stream pipes, terminals and file systems that do not
+    // support mapping through a window
+    return stream_input( tok );
 }
 
 bool
 load_input( tokenizer_t* tok ) {
-    #define MAX_FILE_SIZE 1073741824
     FILE* stream;
     if( tok->input ) {
         stream = fopen( tok->input, "r" );
@@ -89,50 +580,113 @@ load_input( tokenizer_t* tok ) {
     else {
         stream = stdin;
     }
-    if( !stream ) {
-        LOG_ERR( "could not open input stream\n" );
+    return load_stream( tok, stream );
+}
+
+bool
+load_buffer(
+    tokenizer_t* tok,
+    const char*  data,
+    size_t       len
+) {
+    if( !data && len>0 ) {
+        LOG_ERR( "could not read input buffer\n" );
         return false;
     }
-    fseek( stream, 0L, SEEK_END );
-    long   size = ftell( stream );
-    fseek( stream, 0L, SEEK_SET );
-    if( size>=MAX_FILE_SIZE ) {
-        LOG_ERR( "input size is too big\n" );
-        return false;
+    tok->stream     = data;
+    tok->offset     = 0;
+    tok->len        = len;
+    tok->mapped     = false;
+    tok->eof        = true;
+    index_input( tok );
+    return true;
+}
+
+void
+release_input( tokenizer_t* tok ) {
+    if( !tok->mapped ) {
+        return;
     }
-    char* buffer    = calloc( 1, size+1 );
-    if( size>0 && 1!=fread( buffer, size, 1, stream ) ) {
-        LOG_ERR( "could not read input\n" );
-        return false;
+    size_t page     = ( size_t )sysconf( _SC_PAGESIZE );
+    size_t end      = tok->token.start-tok->token.start%page;
+    if( end>tok->released ) {
+        // the pages are read from the file again if they
+        // are ever needed, e.g. by `get_position`
+        madvise( ( char* )tok->stream+tok->released,
+                 end-tok->released, MADV_DONTNEED );
+        tok->released   = end;
     }
-    buffer[ size ]  = EOF;
-    tok->stream     = buffer;
-    #undef MAX_FILE_SIZE
-    return true;
 }
 
 bool
 has_token( tokenizer_t* tok ) {
-    return tok->has_token;
+    return tok->token.type!=TOKEN_EOF;
 }
 
-char
+token_type_t
 get_token( tokenizer_t* tok ) {
-    return tok->token;
+    return tok->token.type;
+}
+
+const char*
+get_text( tokenizer_t* tok ) {
+    return tok->stream+( tok->token.start-tok->offset );
 }
 
-char
-get_prev( tokenizer_t* tok ) {
-    return tok->prev;
+size_t
+get_length( tokenizer_t* tok ) {
+    return tok->token.len;
 }
 
-char
-get_prev_prev( tokenizer_t* tok ) {
-    return tok->prev_prev;
+void
+get_position(
+    tokenizer_t* tok,
+    size_t*      line,
+    size_t*      col
+) {
+    size_t pos      = tok->token.start;
+    if( pos>tok->len ) {
+        pos         = tok->len;
+    }
+    if( pos<tok->offset ) {
+        pos         = tok->offset;
+    }
+    size_t lines    = tok->lines;
+    size_t start    = tok->line_start;
+    const char* end = tok->stream+( pos-tok->offset );
+    for( const char* c=tok->stream;
+         c<end && ( c=memchr( c, '\n', end-c ) )!=NULL;
+         c++ ) {
+        lines++;
+        start       = tok->offset+( c-tok->stream )+1;
+    }
+    *line           = lines+1;
+    *col            = pos-start+1;
+}
+
+static void
+unload_input( tokenizer_t* tok ) {
+    if( tok->mapped ) {
+        munmap( ( void* )tok->stream, tok->len );
+    }
+    delete_indexer( tok->index );
+    if( tok->input && tok->file ) {
+        fclose( tok->file );
+    }
+}
+
+void
+reset_tokenizer(
+    tokenizer_t* tok,
+    char*        input
+) {
+    unload_input( tok );
+    init_tokenizer( tok, input );
 }
 
 void
 delete_tokenizer( tokenizer_t* tok ) {
-    free( tok->stream );
+    unload_input( tok );
+    free( tok->window );
     free( tok );
 }
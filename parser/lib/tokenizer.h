@@ -2,46 +2,130 @@
 #define __TOMLIBC_TOKENIZER_H__
 
 #include "models.h"
+#include "indexer.h"
 
 #include <stdio.h>
+#include <stddef.h>
 
-#define MAX_NUM_LINES 16777216   // 2^24
+/*
+    Inputs that cannot be mapped into memory (pipes,
+    terminals) and files smaller than the window are
+    read through a window that starts at
+    `STREAM_WINDOW_SIZE` characters. Everything from
+    the start of the current token is kept on every
+    refill, so the window only grows if a single token
+    does not fit in it. The tests build with a smaller
+    window, which maps small files and refills often.
+*/
+#ifndef STREAM_WINDOW_SIZE
+#define STREAM_WINDOW_SIZE 65536    // 2^16
+#endif
 
 /*
-    Struct `tokenizer` handles the input stream
-    by reading and returning tokens for the parser.
-    However, this currently returns each character
-    as a token. It allows each state of the parser
-    to determine if it is an acceptable token, and
-    stop parsing as soon as it is not.
+    Enum `token_type` represents the kinds of tokens
+    returned by the tokenizer. Keys and values share
+    some characters, so what a word means depends on
+    where it appears. Words are read as `BAREKEY` by
+    default and the parser calls `lex_value` to read
+    them again as a value when it expects one.
+*/
+typedef enum token_type token_type_t;
+enum
+token_type {
+    /* end of input */
+    TOKEN_EOF,
+    /* could not be read, see `error` */
+    TOKEN_INVALID,
+    /* ` \t` */
+    TOKEN_WHITESPACE,
+    /* `\n` or `\r\n` */
+    TOKEN_NEWLINE,
+    /* `# ...` up to the end of the line */
+    TOKEN_COMMENT,
+    /* `A-Za-z0-9_-` */
+    TOKEN_BAREKEY,
+    /* `"..."`, `'...'`, `"""..."""` and `'''...'''` */
+    TOKEN_BASICSTRING,
+    TOKEN_LITERALSTRING,
+    TOKEN_MLBASICSTRING,
+    TOKEN_MLLITERALSTRING,
+    /* only returned by `lex_value` */
+    TOKEN_NUMBER,
+    TOKEN_DATETIME,
+    TOKEN_BOOL,
+    /* punctuation */
+    TOKEN_DOT,
+    TOKEN_EQUAL,
+    TOKEN_COMMA,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
+    TOKEN_LBRACE,
+    TOKEN_RBRACE,
+};
 
-    TODO: Refactor to parse tokens instead of characters
+/*
+    Struct `token` is a span of the input. For strings
+    the span excludes the quotes, for everything else
+    it is the whole text of the token.
+*/
+typedef struct token token_t;
+struct
+token {
+    token_type_t type;
+    /* input offset of the first character */
+    size_t       start;
+    /* number of characters */
+    size_t       len;
+};
+
+/*
+    Struct `tokenizer` handles the input stream by
+    reading and returning tokens for the parser. The
+    parser looks at one token at a time, using the
+    span of the token to read its text straight from
+    the input buffer.
 */
 typedef struct tokenizer tokenizer_t;
 struct
 tokenizer {
     /* the input filename */
     char*   input;
+    /* the input stream, used for refilling `window` */
+    FILE*   file;
     /* pointer for storing the input buffer */
-    char*   stream;
-    /* the location in the input buffer */
-    int     cursor;
+    const char* stream;
+    /* owned buffer backing `stream` when streaming */
+    char*   window;
+    /* the allocated size of `window` */
+    size_t  size;
+    /* input offset of the first character in `stream` */
+    size_t  offset;
+    /* input offset of the end of the data in `stream` */
+    size_t  len;
+    /* input offset right after `token` */
+    size_t  cursor;
+    /* true if `stream` is a read-only mapping of the input */
+    bool    mapped;
+    /* true once `file` has nothing more to read */
+    bool    eof;
+    /* structural index of a resident input, can be NULL */
+    indexer_t* index;
+    /* false to never index the input, which is set before
+       loading it to keep memory use constant */
+    bool    indexing;
+    /* input offset up to which a mapped input was released */
+    size_t  released;
     /* the last read in token */
-    char    token;
-    /* the token read in before `token` */
-    char    prev;
-    /* the token read in before `prev` */
-    char    prev_prev;
-    /* boolean to indicate if `token` is non-NULL */
-    bool    has_token;
-    /* keeps track if we are on a newline */
+    token_t token;
+    /* the reason `token` is a `TOKEN_INVALID` */
+    const char* error;
+    /* set by the parser while only whitespace has been
+       parsed since the last newline */
     bool    newline;
-    /* line number in the stream */
-    int     line;
-    /* column number in the stream */
-    int     col;
-    /* array where index=line and lines[index]=length */
-    int     lines[ MAX_NUM_LINES ];
+    /* number of newlines before `offset` */
+    size_t  lines;
+    /* input offset of the line `offset` is on */
+    size_t  line_start;
 };
 
 /*
@@ -54,68 +138,147 @@ tokenizer_t*
 new_tokenizer( char* filename );
 
 /*
-    Function `load_input` loads the data from an the input
-    stream onto a char buffer. It also checks to make sure
-    that the input is not too large. Upon any error, it
-    returns false and returns true if everything succeeds.
+    Function `load_input` makes the data from the input
+    stream available as a char buffer. Regular files are
+    mapped read-only into memory and read in place, while
+    small files and anything else (pipes, terminals) are
+    streamed through a window that is refilled by
+    `next_token`. Mapped inputs of at least
+    `INDEX_MIN_SIZE` characters are indexed, so that
+    strings and comments can be skipped over in one go.
+    The end of the input is determined by `len`, so no
+    sentinel is written into the buffer. Upon any error,
+    it returns false and returns true if everything
+    succeeds.
 */
 bool
 load_input( tokenizer_t* tok );
 
 /*
-    Function `next_token` reads the next character from the
-    input stream. It then stores it in the `token` attribute.
-    If we have reached the EOF, the `has_token` attribute is
-    set to false. This also updates all the attributes of the
-    tokenizer appropriately (except `stream`). If we read in
-    a token, i.e. we have not reached EOF, returns 1, else
-    returns 0.
+    Function `load_stream` is the same as `load_input`
+    but reads from an already opened `stream`. The
+    stream is not closed by `delete_tokenizer`.
+*/
+bool
+load_stream(
+    tokenizer_t* tok,
+    FILE*        stream
+);
+
+/*
+    Function `load_buffer` reads `len` characters of
+    `data` in place, without copying them. The buffer is
+    owned by the caller and has to outlive the tokenizer.
+    It does not need to be terminated, so it can be any
+    range inside a larger buffer. Like mapped inputs,
+    buffers of at least `INDEX_MIN_SIZE` characters are
+    indexed.
+*/
+bool
+load_buffer(
+    tokenizer_t* tok,
+    const char*  data,
+    size_t       len
+);
+
+/*
+    Function `next_token` reads the next token from the
+    input stream and stores it in the `token` attribute.
+    Runs of whitespace are returned as a single token.
+    Characters that cannot start a token are returned as
+    a `TOKEN_INVALID` of length 1, and unterminated strings
+    or bad comments as a `TOKEN_INVALID` spanning what was
+    read, with `error` describing the problem. Once we
+    have reached EOF, every call returns a `TOKEN_EOF`.
+    Returns 1 if we read in a non-EOF token, else 0.
 */
 int
 next_token( tokenizer_t* tok );
 
 /*
-    Function `backtrack` is used to move the `cursor` back in
-    the input stream. This allows look-ahead operations to make
-    parsing decisions. For example, let's say we want to decide
-    whether to parse something as a date or a number. To know if
-    there is a `-` a few chars ahead, we call `next_token`.
-    However, in the case that there isn't, we need to go back
-    to where we were and re-parse it as a number. This function
-    takes an argument `count` and backtracks that many characters.
-    To maintain the values of `prev` and `prev_prev`, this goes
-    back 2 extra characters and calls `next_token` twice to
-    re-populate them.
+    Function `lex_value` reads the current token again
+    as a value. Words become a `TOKEN_NUMBER`, a
+    `TOKEN_DATETIME` or a `TOKEN_BOOL`, or a
+    `TOKEN_INVALID` if they are none of those. A date
+    followed by a space and a time is read as a single
+    `TOKEN_DATETIME`. Other tokens are left as they are.
 */
 void
-backtrack(
+lex_value( tokenizer_t* tok );
+
+/*
+    Function `peek` returns the character `n` positions
+    after the start of `token`, or EOF if the input ends
+    before it. Nothing is consumed, so the parser can
+    look ahead of the current token without reading the
+    next one. Characters are read from the input buffer
+    directly, refilling the window if needed, which never
+    drops the text of `token`.
+*/
+int
+peek(
     tokenizer_t* tok,
-    int count
+    size_t       n
 );
 
 /*
-    Function `has_token` returns true if the boolean attribute
-    is set to true. This should be used callers to query if
-    the tokenizer has a non-EOF token waiting to be parsed.
+    Function `release_input` tells the system that the
+    pages of a mapped input before `token` are no longer
+    needed, so reading a large input front to back does
+    not keep all of it in memory. Streamed inputs only
+    keep a window anyway and buffers belong to the caller,
+    so nothing is done for those.
+*/
+void
+release_input( tokenizer_t* tok );
+
+/*
+    Function `has_token` returns true if the tokenizer
+    has a non-EOF token waiting to be parsed.
 */
 bool
 has_token( tokenizer_t* tok );
 
 /*
-    Functions `get_token`, `get_prev` and `get_prev_prev`
-    returns the `token`, `prev` and `prev_prev` attributes
-    held by the tokenizer, respectively. This should be
-    used by callers to access the tokens read in by the
-    tokenizer.
+    Functions `get_token`, `get_text` and `get_length`
+    return the type, a pointer to the first character
+    and the number of characters of `token`. The text
+    is only valid until the next call to `next_token`.
 */
-char
-get_token       ( tokenizer_t* tok );
+token_type_t
+get_token ( tokenizer_t* tok );
 
-char
-get_prev        ( tokenizer_t* tok );
+const char*
+get_text  ( tokenizer_t* tok );
 
-char
-get_prev_prev   ( tokenizer_t* tok );
+size_t
+get_length( tokenizer_t* tok );
+
+/*
+    Function `get_position` computes the line and column
+    of `token`, both starting at 1. Positions are not
+    tracked while reading, they are derived from the
+    start of the token by counting the newlines before
+    it, so this should only be used for reporting errors.
+*/
+void
+get_position(
+    tokenizer_t* tok,
+    size_t*      line,
+    size_t*      col
+);
+
+/*
+    Function `reset_tokenizer` releases the input of `tok`
+    and prepares it for reading `input` like a new
+    tokenizer would, keeping the window it allocated so
+    that tokenizers can be reused across many inputs.
+*/
+void
+reset_tokenizer(
+    tokenizer_t* tok,
+    char*        input
+);
 
 void
 delete_tokenizer( tokenizer_t* tok );
@@ -0,0 +1,3 @@
+#include "utils.h"
+
+_Thread_local FILE* log_output = NULL;
@@ -3,17 +3,27 @@
 
 #include <stdio.h>
 
+/*
+    Variable `log_output` is the stream `LOG_ERR` writes
+    to on the calling thread, which is stderr while it is
+    NULL. Setting it keeps the errors of one thread from
+    mixing with the others.
+*/
+extern _Thread_local FILE* log_output;
+
+#define LOG_STREAM ( log_output ? log_output : stderr )
+
 /*
     Macro `LOG_ERR` is for logging an error
-    message to stderr, that also specifies
+    message to `LOG_STREAM`, that also specifies
     which file, line and function the error
     was raised in.
 */
-#define LOG_ERR( ... )                   \
-    do {                                 \
-        fprintf( stderr, "%s:%d [%s]: ", \
-        __FILE__, __LINE__, __func__ );  \
-        fprintf( stderr, __VA_ARGS__ );  \
+#define LOG_ERR( ... )                       \
+    do {                                     \
+        fprintf( LOG_STREAM, "%s:%d [%s]: ", \
+        __FILE__, __LINE__, __func__ );      \
+        fprintf( LOG_STREAM, __VA_ARGS__ );  \
     } while( 0 )
 
 /*
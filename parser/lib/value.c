@@ -1,90 +1,101 @@
 #include "key.h"
 #include "value.h"
+#include "arena.h"
+#include "utils.h"
 
 #include <string.h>
 #include <stdlib.h>
-#include <time.h>
+#include <limits.h>
 
 toml_value_t*
-new_string( const char* s ) {
-    toml_value_t* v = calloc( 1, sizeof( toml_value_t ) );
+new_string(
+    char*  s,
+    size_t len
+) {
+    // the length is kept in an `int` next to the pointer,
+    // which keeps values at 24 bytes
+    RETURN_IF_FAILED( len<=INT_MAX, "string is too long\n" );
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
     v->type         = TOML_STRING;
-    v->data         = calloc( 1, strlen( s )+1 );
-    memcpy( v->data, s, strlen( s ) );
+    v->data         = s;
+    v->len          = len;
+    return v;
+}
+
+toml_value_t*
+new_integer( int64_t i ) {
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
+    v->type         = TOML_INT;
+    v->integer      = i;
+    if( i>=INT_MIN && i<=INT_MAX ) {
+        v->narrow   = ( int )i;
+    }
     return v;
 }
 
 toml_value_t*
-new_number(
-    double*           d,
-    toml_value_type_t type,
-    size_t            precision,
-    bool              scientific
+new_float(
+    double d,
+    int    precision,
+    bool   scientific
 ) {
-    toml_value_t* v = calloc( 1, sizeof( toml_value_t ) );
-    v->type         = type;
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
+    v->type         = TOML_FLOAT;
+    v->number       = d;
+    v->precision    = ( precision<UINT16_MAX ) ? precision : UINT16_MAX;
     v->scientific   = scientific;
-    v->precision    = precision;
-    v->data         = calloc( 1, sizeof( double ) );
-    memcpy( v->data, d, sizeof( double ) );
     return v;
 }
 
 toml_value_t*
-new_datetime(
-    struct tm*        dt,
-    toml_value_type_t type,
-    char*             format,
-    int               millis
-) {
-    toml_value_t* v = calloc( 1, sizeof( toml_value_t ) );
-    v->type         = type;
-    v->precision    = millis;
-    v->data         = calloc( 1, sizeof( struct tm ) );
-    memset( v->format, 0, TOML_MAX_DATE_FORMAT );
-    if( strlen( format )<TOML_MAX_DATE_FORMAT ) {
-        memcpy( v->format, format, strlen( format ) );
-    }
-    memcpy( v->data, dt, sizeof( struct tm ) );
+new_bool( bool b ) {
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
+    v->type         = TOML_BOOL;
+    v->boolean      = b;
+    return v;
+}
+
+toml_value_t*
+new_datetime( const toml_datetime_t* dt ) {
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
+    v->type         = dt->kind;
+    v->datetime     = *dt;
     return v;
 }
 
 toml_value_t*
 new_array() {
-    toml_value_t* v = calloc( 1, sizeof( toml_value_t ) );
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
     v->type = TOML_ARRAY;
-    v->arr  = calloc( 1, sizeof( toml_value_t* )*TOML_MAX_ARRAY_LENGTH );
+    v->arr  = NULL;
     v->len  = 0;
+    v->size = 0;
     return v;
 }
 
 toml_value_t*
-new_inline_table( toml_key_t* k ) {
-    toml_value_t* v = calloc( 1, sizeof( toml_value_t ) );
-    v->type         = TOML_INLINETABLE;
-    toml_key_t* h   = new_key( TOML_KEY );
-    for( khiter_t ki=kh_begin( k->subkeys );
-         ki!=kh_end( k->subkeys );
-         ++ki ) {
-        if( kh_exist( k->subkeys, ki ) ) {
-            add_subkey( h, kh_value( k->subkeys, ki ) );
-        }
+push_value(
+    toml_value_t* arr,
+    toml_value_t* v
+) {
+    if( arr->len==arr->size ) {
+        RETURN_IF_FAILED( arr->size<=INT_MAX/2, "array is too long\n" );
+        int             size = arr->size ? arr->size*2 : 4;
+        toml_value_t**  a    = arena_realloc( current_arena, arr->arr,
+                                              sizeof( toml_value_t* )*size );
+        RETURN_IF_FAILED( a, "could not grow array\n" );
+        arr->arr    = a;
+        arr->size   = size;
     }
-    v->data = h;
-    return v;
+    arr->arr[ arr->len++ ] = v;
+    return arr;
 }
 
-void
-delete_value( toml_value_t* v ) {
-    if( !v ) return;
-    if( v->arr ) {
-        for( toml_value_t** iter=v->arr; *iter!=NULL; iter++ ) {
-            delete_value( *iter );
-        }
-        free( v->arr );
-    }
-    if( v->data ) {
-        free( v->data );
-    }
-    free( v );
+toml_value_t*
+new_inline_table( toml_key_t* k ) {
+    toml_value_t* v = arena_alloc( current_arena, sizeof( toml_value_t ) );
+    v->type         = TOML_INLINETABLE;
+    k->type         = TOML_KEY;
+    v->data         = k;
+    return v;
 }
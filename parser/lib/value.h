@@ -3,60 +3,71 @@
 
 #include "models.h"
 
-#include <time.h>
 
 /*
-    Function `delete_value` frees up all the memory
-    that is associated with value `v`.
+    Values are allocated from the current arena, like
+    keys, and are freed along with their document.
+
+    Function `new_array` creates an empty array value,
+    whose `arr` attribute grows as values are added to it
+    with `push_value`.
 */
-void
-delete_value( toml_value_t* v );
+toml_value_t*
+new_array();
 
 /*
-    Function `new_array` allocates a buffer for an
-    array of `toml_value_t` and returns a pointer to it.
-    This is stored in the `arr` attribute.
+    Function `push_value` appends `v` to the array `arr`,
+    doubling the room in `arr->arr` when it is full.
+    Returns `arr`, or NULL if it could not grow.
 */
 toml_value_t*
-new_array();
+push_value(
+    toml_value_t* arr,
+    toml_value_t* v
+);
 
 /*
     Function `new_inline_table` takes a key `k` as
     it's argument which can contain one or many key
-    value pairs, including subkeys. It then allocates
-    some new memory for a key and adds all subkeys of
-    `k` as subkeys of this newly allocated key. It
-    returns a pointer to the newly allocated value.
-    The `data` attribute contains the newly created key.
+    value pairs, including subkeys. It stores `k` in the
+    `data` attribute of the newly allocated value, to
+    which it returns a pointer.
 */
 toml_value_t*
 new_inline_table( toml_key_t* k );
 
 /*
-    Functions `new_string`, `new_datetime` and `new_number`
-    allocates some memory for each of these datatypes
-    respectively. It then copies over the passed in data
-    into the `data` attribute of the value. Finally, like
-    the other functions, it returns a pointer to the newly
-    allocated value.
+    Function `new_string` stores the string `s` of `len`
+    chars in the `data` attribute of the newly allocated
+    value, to which it returns a pointer. The string is
+    not copied, so it has to be allocated from the
+    current arena, and be followed by a NUL. Strings
+    longer than `INT_MAX` chars are rejected with NULL.
+    Functions `new_integer`, `new_float`, `new_bool` and
+    `new_datetime` store their scalar in the value itself,
+    and like the other functions, return a pointer to the
+    newly allocated value.
 */
 toml_value_t*
-new_string( const char* s );
+new_string(
+    char*  s,
+    size_t len
+);
 
 toml_value_t*
-new_datetime(
-    struct tm*        dt,
-    toml_value_type_t type,
-    char*             format,
-    int               millis
-);
+new_integer( int64_t i );
 
 toml_value_t*
-new_number(
-    double*           d,
-    toml_value_type_t type,
-    size_t            precision,
-    bool              scientific
+new_float(
+    double d,
+    int    precision,
+    bool   scientific
 );
 
+toml_value_t*
+new_bool( bool b );
+
+toml_value_t*
+new_datetime( const toml_datetime_t* dt );
+
 #endif
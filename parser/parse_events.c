@@ -0,0 +1,368 @@
+#include "parse_events.h"
+#include "parse_keys.h"
+#include "parse_values.h"
+#include "parse_utils.h"
+
+#include "lib/utils.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+static bool
+emit(
+    events_t*     ev,
+    toml_event_t* e
+) {
+    if( ev->handler && !ev->handler( e, ev->data ) ) {
+        ev->stopped = true;
+        return false;
+    }
+    return true;
+}
+
+static bool
+emit_type(
+    events_t*         ev,
+    toml_event_type_t type
+) {
+    toml_event_t e = { 0 };
+    e.type         = type;
+    return emit( ev, &e );
+}
+
+/*
+    A string can be reported as a view into the input if
+    decoding it would not change anything, which means it
+    has no escapes, no `\r\n` and only newlines and tabs
+    as control characters.
+*/
+static bool
+is_view(
+    const char* s,
+    size_t      len,
+    bool        escapes,
+    bool        multi
+) {
+    size_t i = 0;
+    while( ( i+=span_plain( s+i, len-i, escapes ) )<len ) {
+        if( !multi || !is_newline( s[ i ] ) ) {
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+static bool
+parse_string_events(
+    tokenizer_t* tok,
+    events_t*    ev,
+    bool         basic,
+    bool         multi
+) {
+    toml_event_t e  = { 0 };
+    e.type          = TOML_EVENT_VALUE;
+    e.value         = TOML_STRING;
+    const char* s   = get_text( tok );
+    size_t      len = get_length( tok );
+    // a newline right after the opening delimiter is trimmed
+    if( multi && len>1 && is_return( s[ 0 ] ) && is_newline( s[ 1 ] ) ) {
+        s          += 2;
+        len        -= 2;
+    }
+    else if( multi && len>0 && is_newline( s[ 0 ] ) ) {
+        s++;
+        len--;
+    }
+    if( is_view( s, len, basic, multi ) ) {
+        // the view has to be reported before the next
+        // token can move the window
+        e.string    = s;
+        e.len       = len;
+        bool ok     = emit( ev, &e );
+        next_token( tok );
+        return ok;
+    }
+    char* value     = malloc( get_length( tok )+1 );
+    RETURN_IF_FAILED( value, "could not allocate string\n" );
+    char* v         = basic ? parse_basicstring( tok, value, multi, &e.len )
+                            : parse_literalstring( tok, value, multi, &e.len );
+    if( !v ) {
+        LOG_ERR( "could not parse string\n" );
+    }
+    e.string        = value;
+    bool  ok        = v && emit( ev, &e );
+    free( value );
+    return ok;
+}
+
+bool
+parse_path_events(
+    tokenizer_t* tok,
+    events_t*    ev,
+    token_type_t end,
+    int*         depth
+) {
+    int    n            = 0;
+    bool   expecting    = true;
+    size_t used         = 0;
+    // `ids` can move while it grows, so the parts are
+    // only pointed at once they are all decoded
+    size_t offsets[ TOML_MAX_KEY_DEPTH ];
+    while( has_token( tok ) ) {
+        if( get_token( tok )==end ) {
+            RETURN_IF_FAILED( !expecting, "expected a key\n" );
+            for( int i=0; i<n; i++ ) {
+                ev->path[ i ]   = ev->ids+offsets[ i ];
+            }
+            *depth  = n;
+            return true;
+        }
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
+            parse_whitespace( tok );
+        }
+        else if( get_token( tok )==TOKEN_DOT ) {
+            RETURN_IF_FAILED( !expecting, "found . while expecting a key\n" );
+            expecting   = true;
+            next_token( tok );
+        }
+        else {
+            RETURN_IF_FAILED( expecting, "expected . between keys\n" );
+            RETURN_IF_FAILED( n<TOML_MAX_KEY_DEPTH, "key has too many parts\n" );
+            size_t need     = used+get_length( tok )+1;
+            if( need>ev->size ) {
+                size_t size = ev->size ? ev->size : 256;
+                while( size<need ) {
+                    size   *= 2;
+                }
+                char* ids   = realloc( ev->ids, size );
+                RETURN_IF_FAILED( ids, "could not allocate key\n" );
+                ev->ids     = ids;
+                ev->size    = size;
+            }
+            size_t len;
+            RETURN_IF_FAILED( parse_keyid( tok, ev->ids+used, &len ), "failed to parse key\n" );
+            offsets[ n++ ]  = used;
+            used           += len+1;
+            expecting       = false;
+        }
+    }
+    LOG_ERR( "unexpected end of input in key\n" );
+    return false;
+}
+
+bool
+parse_array_events(
+    tokenizer_t* tok,
+    events_t*    ev
+) {
+    bool sep = true;
+    while( has_token( tok ) ) {
+        if( get_token( tok )==TOKEN_RBRACKET ) {
+            next_token( tok );
+            return emit_type( ev, TOML_EVENT_ARRAY_END );
+        }
+        else if( get_token( tok )==TOKEN_COMMA ) {
+            RETURN_IF_FAILED( !sep, "expected value but got , instead\n" );
+            sep = true;
+            next_token( tok );
+        }
+        else if( parse_newline( tok ) ) {
+            next_token( tok );
+        }
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
+            parse_whitespace( tok );
+        }
+        else if( get_token( tok )==TOKEN_COMMENT ) {
+            bool ok = parse_comment( tok );
+            RETURN_IF_FAILED( ok, "invalid comment\n" );
+        }
+        else {
+            RETURN_IF_FAILED( sep, "expected , between elements\n" );
+            if( !parse_value_events( tok, ev ) ) {
+                return false;
+            }
+            sep = false;
+        }
+    }
+    return false;
+}
+
+bool
+parse_inlinetable_events(
+    tokenizer_t* tok,
+    events_t*    ev
+) {
+    bool sep   = true;
+    bool first = true;
+    while( has_token( tok ) ) {
+        if( get_token( tok )==TOKEN_RBRACE ) {
+            RETURN_IF_FAILED( ( !sep || first ), "cannot have trailing comma in inline table\n" );
+            next_token( tok );
+            return emit_type( ev, TOML_EVENT_INLINETABLE_END );
+        }
+        else if( get_token( tok )==TOKEN_COMMA ) {
+            RETURN_IF_FAILED( !sep, "expected key-value but got , instead" );
+            sep = true;
+            next_token( tok );
+        }
+        else if( parse_newline( tok ) ) {
+            LOG_ERR( "found newline in inline table\n" );
+            break;
+        }
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
+            parse_whitespace( tok );
+        }
+        else {
+            RETURN_IF_FAILED( sep, "expected , between elements\n" );
+            toml_event_t e = { 0 };
+            e.type         = TOML_EVENT_KEY;
+            e.path         = ev->path;
+            RETURN_IF_FAILED( parse_path_events( tok, ev, TOKEN_EQUAL, &e.depth ),
+                              "failed to parse key\n" );
+            next_token( tok );
+            if( !emit( ev, &e ) || !parse_value_events( tok, ev ) ) {
+                return false;
+            }
+            parse_whitespace( tok );
+            sep   = false;
+            first = false;
+        }
+    }
+    return false;
+}
+
+bool
+parse_value_events(
+    tokenizer_t* tok,
+    events_t*    ev
+) {
+    toml_event_t e = { 0 };
+    e.type         = TOML_EVENT_VALUE;
+    parse_whitespace( tok );
+    lex_value( tok );
+    if( parse_newline( tok ) || !has_token( tok ) ) {
+        LOG_ERR( "got a newline before any value\n" );
+    }
+    else if( get_token( tok )==TOKEN_BASICSTRING ||
+             get_token( tok )==TOKEN_MLBASICSTRING ) {
+        return parse_string_events( tok, ev, true,
+                                    get_token( tok )==TOKEN_MLBASICSTRING );
+    }
+    else if( get_token( tok )==TOKEN_LITERALSTRING ||
+             get_token( tok )==TOKEN_MLLITERALSTRING ) {
+        return parse_string_events( tok, ev, false,
+                                    get_token( tok )==TOKEN_MLLITERALSTRING );
+    }
+    else if( get_token( tok )==TOKEN_DATETIME ) {
+        toml_datetime_t dt;
+        RETURN_IF_FAILED( parse_datetime( tok, &dt ), "could not parse datetime\n" );
+        e.value          = dt.kind;
+        e.datetime       = &dt;
+        return emit( ev, &e );
+    }
+    else if( get_token( tok )==TOKEN_NUMBER ) {
+        number_t  num;
+        number_t* n      = parse_number( tok, &e.number, &num );
+        RETURN_IF_FAILED( n, "could not parse number\n" );
+        e.value          = n->type;
+        e.integer        = n->integer;
+        e.precision      = n->precision;
+        e.scientific     = n->scientific;
+        return emit( ev, &e );
+    }
+    else if( get_token( tok )==TOKEN_LBRACKET ) {
+        next_token( tok );
+        return emit_type( ev, TOML_EVENT_ARRAY_BEGIN ) &&
+               parse_array_events( tok, ev );
+    }
+    else if( get_token( tok )==TOKEN_LBRACE ) {
+        next_token( tok );
+        return emit_type( ev, TOML_EVENT_INLINETABLE_BEGIN ) &&
+               parse_inlinetable_events( tok, ev );
+    }
+    else if( get_token( tok )==TOKEN_BOOL ) {
+        RETURN_IF_FAILED( parse_boolean( tok, &e.boolean ), "could not parse boolean\n" );
+        e.value          = TOML_BOOL;
+        return emit( ev, &e );
+    }
+    else if( get_token( tok )==TOKEN_INVALID ) {
+        LOG_ERR( "%s", tok->error );
+    }
+    else {
+        LOG_ERR( "unknown value type\n" );
+    }
+    return false;
+}
+
+bool
+parse_header_events(
+    tokenizer_t*  tok,
+    events_t*     ev,
+    toml_event_t* e
+) {
+    memset( e, 0, sizeof( toml_event_t ) );
+    tok->newline    = false;
+    e->type         = TOML_EVENT_TABLE;
+    e->path         = ev->path;
+    // [[ means we are parsing an arraytable
+    if( peek( tok, 1 )=='[' ) {
+        e->type     = TOML_EVENT_ARRAYTABLE;
+        next_token( tok );
+    }
+    next_token( tok );
+    RETURN_IF_FAILED( parse_path_events( tok, ev, TOKEN_RBRACKET, &e->depth ),
+                      "failed to parse table\n" );
+    if( e->type==TOML_EVENT_ARRAYTABLE ) {
+        RETURN_IF_FAILED( peek( tok, 1 )==']', "expected ]] at end of array of tables\n" );
+        next_token( tok );
+    }
+    next_token( tok );
+    return true;
+}
+
+bool
+parse_keyval_events(
+    tokenizer_t* tok,
+    events_t*    ev
+) {
+    if( get_token( tok )==TOKEN_COMMENT ) {
+        bool ok = parse_comment( tok );
+        RETURN_IF_FAILED( ok, "invalid comment\n" );
+        return true;
+    }
+    else if( get_token( tok )==TOKEN_WHITESPACE ) {
+        parse_whitespace( tok );
+        return true;
+    }
+    else if( parse_newline( tok ) ) {
+        next_token( tok );
+        tok->newline = true;
+        return true;
+    }
+    else if( get_token( tok )==TOKEN_LBRACKET ) {
+        toml_event_t e;
+        return parse_header_events( tok, ev, &e ) && emit( ev, &e );
+    }
+    // keys have to start on a new line, ignoring any
+    // white space found at the beginning of the line
+    else if( tok->newline ) {
+        tok->newline    = false;
+        toml_event_t e  = { 0 };
+        e.type          = TOML_EVENT_KEY;
+        e.path          = ev->path;
+        RETURN_IF_FAILED( parse_path_events( tok, ev, TOKEN_EQUAL, &e.depth ),
+                          "failed to parse key\n" );
+        next_token( tok );
+        if( !emit( ev, &e ) || !parse_value_events( tok, ev ) ) {
+            return false;
+        }
+        parse_whitespace( tok );
+        return true;
+    }
+    else if( get_token( tok )==TOKEN_INVALID )
+        LOG_ERR( "%s", tok->error );
+    else
+        LOG_ERR( "unexpected %.*s\n", ( int )get_length( tok ), get_text( tok ) );
+    return false;
+}
@@ -0,0 +1,89 @@
+#ifndef __TOMLIBC_PARSE_EVENTS_H__
+#define __TOMLIBC_PARSE_EVENTS_H__
+
+#include "lib/tokenizer.h"
+
+/*
+    Struct `events` holds the state of the event parser.
+    The parts of the last parsed dotted key are decoded
+    into `ids` and reported through `path`, so parsing
+    never allocates any keys or values. `ids` grows with
+    the longest key and is freed with `free` once the
+    parser is done. A NULL `handler` only checks the
+    syntax of the input.
+*/
+typedef struct events events_t;
+struct
+events {
+    /* called with every event, can be NULL */
+    toml_event_handler_t handler;
+    /* passed to every call of `handler` */
+    void*                data;
+    /* true once `handler` returned false */
+    bool                 stopped;
+    /* storage for the parts of the current dotted key,
+       each followed by a NUL */
+    char*                ids;
+    size_t               size;
+    const char*          path[ TOML_MAX_KEY_DEPTH ];
+};
+
+/*
+    Function `parse_path_events` decodes a dotted key up
+    to the `end` token into `path`, storing the number of
+    parts in `depth`. The `end` token is left as the
+    current token. Returns false on parsing failure.
+*/
+bool
+parse_path_events(
+    tokenizer_t* tok,
+    events_t*    ev,
+    token_type_t end,
+    int*         depth
+);
+
+/*
+    Functions `parse_value_events`, `parse_array_events`
+    and `parse_inlinetable_events` follow the grammar of
+    `parse_value`, `parse_array` and `parse_inlinetable`,
+    using the same routines for the scalar values, but
+    report what they parse to the handler instead of
+    building values. The array and inline table versions
+    start right after the opening bracket or brace. All of
+    them return false on parsing failure or if the handler
+    stopped the parser.
+*/
+bool
+parse_value_events      ( tokenizer_t* tok, events_t* ev );
+
+bool
+parse_array_events      ( tokenizer_t* tok, events_t* ev );
+
+bool
+parse_inlinetable_events( tokenizer_t* tok, events_t* ev );
+
+/*
+    Function `parse_header_events` parses the `[a.b]` or
+    `[[a.b]]` header starting at the current `[` token
+    into `e` without reporting it. Returns false on
+    parsing failure.
+*/
+bool
+parse_header_events(
+    tokenizer_t*  tok,
+    events_t*     ev,
+    toml_event_t* e
+);
+
+/*
+    Function `parse_keyval_events` is the counterpart of
+    `parse_keyval`. Only the syntax of the input is
+    checked, since detecting keys and tables that are
+    defined twice needs the tree that is never built.
+    Returns false on parsing failure or if the handler
+    stopped the parser, which is told apart by `stopped`.
+*/
+bool
+parse_keyval_events( tokenizer_t* tok, events_t* ev );
+
+#endif
@@ -7,154 +7,173 @@
 #include "lib/utils.h"
 
 #include <string.h>
+#include <stdlib.h>
 
-toml_key_t*
-parse_barekey(
+static toml_key_t*
+end_key(
     tokenizer_t*    tok,
-    char            end,
+    char*           id,
+    size_t          len,
+    token_type_t    end,
     toml_key_type_t branch,
     toml_key_type_t leaf
 ) {
-    char id[ TOML_MAX_ID_LENGTH ] = { 0 };
-    int  idx  = 0;
-    bool done = false;
-
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_ID_LENGTH, "buffer overflow\n" );
-        if( is_dot( get_token( tok ) ) ) {
-            RETURN_IF_FAILED( idx!=0, "key cannot be empty\n" );
-            toml_key_t* subkey = new_key( branch );
-            memcpy( subkey->id, id, strlen( id ) );
-            return subkey;
-        }
-        else if( get_token( tok )==end ) {
-            RETURN_IF_FAILED( idx!=0, "key cannot be empty\n" );
-            toml_key_t* subkey = new_key( leaf );
-            memcpy( subkey->id, id, strlen( id ) );
-            return subkey;
-        }
-        else if( is_whitespace( get_token( tok ) ) ) {
-            // bare keys cannot contain whitespace inside each
-            // key, so we use the `done` variable to track it
-            done = true;
-            parse_whitespace( tok );
-        }
-        else if( is_bare_ascii( get_token( tok ) ) && !done ) {
-            id[ idx++ ] = get_token( tok );
-            next_token( tok );
-        }
-        else {
-            LOG_ERR( "unknown character %c\n", get_token( tok ) );
-            break;
-        }
+    if( get_token( tok )==TOKEN_WHITESPACE ) {
+        parse_whitespace( tok );
+    }
+    if( get_token( tok )==TOKEN_DOT || get_token( tok )==end ) {
+        toml_key_t* subkey = new_key( get_token( tok )==end ? leaf : branch );
+        subkey->id         = id;
+        subkey->len        = len;
+        return subkey;
     }
+    LOG_ERR( "unknown token after end of key %s\n", id );
     return NULL;
 }
 
-toml_key_t*
-parse_basicquotedkey(
-    tokenizer_t*    tok,
-    char            end,
-    toml_key_type_t branch,
-    toml_key_type_t leaf
+/*
+    The decoded key is never longer than the token, so
+    `id` only has to hold the length of the token and the
+    terminating NUL. Its decoded length is stored in
+    `len`, since escapes can put NULs into it.
+*/
+static bool
+decode_barekey(
+    tokenizer_t* tok,
+    char*        id,
+    size_t*      len
 ) {
-    char id[ TOML_MAX_ID_LENGTH ] = { 0 };
-    int  idx = 0;
+    if( get_token( tok )==TOKEN_INVALID ) {
+        LOG_ERR( "%s", tok->error );
+        return false;
+    }
+    RETURN_IF_FAILED( get_token( tok )==TOKEN_BAREKEY, "expected a key\n" );
+    memcpy( id, get_text( tok ), get_length( tok ) );
+    id[ get_length( tok ) ] = '\0';
+    *len                    = get_length( tok );
+    return true;
+}
 
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_ID_LENGTH, "buffer overflow\n" );
-        if( is_basicstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            if( is_whitespace( get_token( tok ) ) ) {
-                parse_whitespace( tok );
-            }
-            if( is_dot( get_token( tok ) ) ) {
-                toml_key_t* subkey = new_key( branch );
-                memcpy( subkey->id, id, strlen( id ) );
-                return subkey;
-            }
-            else if( get_token( tok )==end ) {
-                toml_key_t* subkey = new_key( leaf );
-                memcpy( subkey->id, id, strlen( id ) );
-                return subkey;
-            }
-            LOG_ERR( "unknown character %c after end of key\n", get_token( tok ) );
-            break;
-        }
-        else if( is_newline( get_token( tok ) ) ) {
-            LOG_ERR( "unescaped newline while parsing key\n" );
-            break;
-        }
-        else if( is_escape( get_token( tok ) ) ) {
-            next_token( tok );
+static bool
+decode_basicquotedkey(
+    tokenizer_t* tok,
+    char*        id,
+    size_t*      len
+) {
+    size_t      idx = 0;
+    const char* c   = get_text( tok );
+    const char* e   = c+get_length( tok );
+    while( c<e ) {
+        if( is_escape( *c ) ) {
+            c++;
             char escaped[ 5 ] = { 0 };
-            int c             = parse_escape( tok, escaped, 5 );
-            RETURN_IF_FAILED( c!=0, "unknown escape sequence \\%c\n", get_token( tok ) );
-            RETURN_IF_FAILED( c<5,  "parsed escape sequence is too long\n" );
-            for( int i=0; i<c; i++ ) {
-                id[ idx++ ] = escaped[ i ];
-                RETURN_IF_FAILED( idx<TOML_MAX_ID_LENGTH, "buffer overflow\n" );
-            }
-            // parse_escape will parse everything and move on to the next token
-            // so we call backtrack here to offset the next_token call outside
-            backtrack( tok, 1 );
-        }
-        else if( is_control( get_token( tok ) ) ) {
+            int n             = parse_escape( &c, e, escaped, 5 );
+            RETURN_IF_FAILED( n!=0, "unknown escape sequence \\%c\n", c<e ? *c : ' ' );
+            RETURN_IF_FAILED( n<5,  "parsed escape sequence is too long\n" );
+            memcpy( id+idx, escaped, n );
+            idx += n;
+            continue;
+        }
+        else if( is_control( *c ) ) {
             LOG_ERR( "control characters need to be escaped\n" );
-            break;
-        }
-        else {
-            id[ idx++ ] = get_token( tok );
+            return false;
         }
+        id[ idx++ ] = *c++;
+    }
+    id[ idx ] = '\0';
+    *len      = idx;
+    return true;
+}
+
+static bool
+decode_literalquotedkey(
+    tokenizer_t* tok,
+    char*        id,
+    size_t*      len
+) {
+    const char* c   = get_text( tok );
+    *len            = get_length( tok );
+    for( size_t i=0; i<*len; i++ ) {
+        RETURN_IF_FAILED( !is_control_literal( c[ i ] ),
+                          "control characters need to be escaped\n" );
+    }
+    memcpy( id, c, *len );
+    id[ *len ] = '\0';
+    return true;
+}
+
+bool
+parse_keyid(
+    tokenizer_t* tok,
+    char*        id,
+    size_t*      len
+) {
+    bool ok;
+    if( get_token( tok )==TOKEN_BASICSTRING ) {
+        ok = decode_basicquotedkey( tok, id, len );
+    }
+    else if( get_token( tok )==TOKEN_LITERALSTRING ) {
+        ok = decode_literalquotedkey( tok, id, len );
+    }
+    else {
+        ok = decode_barekey( tok, id, len );
+    }
+    if( ok ) {
         next_token( tok );
     }
-    return NULL;
+    return ok;
+}
+
+/*
+    Keys are decoded straight into the arena of the
+    document they belong to.
+*/
+static toml_key_t*
+parse_id(
+    tokenizer_t*    tok,
+    bool            ( *decode )( tokenizer_t*, char*, size_t* ),
+    token_type_t    end,
+    toml_key_type_t branch,
+    toml_key_type_t leaf
+) {
+    char*  id   = arena_alloc( current_arena, get_length( tok )+1 );
+    RETURN_IF_FAILED( id, "could not allocate key\n" );
+    size_t len;
+    if( !decode( tok, id, &len ) ) {
+        return NULL;
+    }
+    next_token( tok );
+    return end_key( tok, id, len, end, branch, leaf );
 }
 
 toml_key_t*
-parse_literalquotedkey(
+parse_barekey(
     tokenizer_t*    tok,
-    char            end,
+    token_type_t    end,
     toml_key_type_t branch,
     toml_key_type_t leaf
 ) {
-    char id[ TOML_MAX_ID_LENGTH ] = { 0 };
-    int  idx = 0;
+    return parse_id( tok, decode_barekey, end, branch, leaf );
+}
 
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_ID_LENGTH, "buffer overflow\n" );
-        if( is_literalstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            if( is_whitespace( get_token( tok ) ) ) {
-                parse_whitespace( tok );
-            }
-            if( is_dot( get_token( tok ) ) ) {
-                toml_key_t* subkey = new_key( branch );
-                memcpy( subkey->id, id, strlen( id ) );
-                return subkey;
-            }
-            else if( get_token( tok )==end ) {
-                toml_key_t* subkey = new_key( leaf );
-                memcpy( subkey->id, id, strlen( id ) );
-                return subkey;
-            }
-            LOG_ERR( "unknown character %c after end of key\n", get_token( tok ) );
-            break;
-        }
-        else if( is_newline( get_token( tok ) ) ) {
-            LOG_ERR( "unescaped newline while parsing key\n" );
-            break;
-        }
-        else if( is_control_literal( get_token( tok ) ) ) {
-            LOG_ERR( "control characters need to be escaped\n" );
-            break;
-        }
-        else {
-            id[ idx++ ] = get_token( tok );
-        }
-        next_token( tok );
-    }
-    return NULL;
+toml_key_t*
+parse_basicquotedkey(
+    tokenizer_t*    tok,
+    token_type_t    end,
+    toml_key_type_t branch,
+    toml_key_type_t leaf
+) {
+    return parse_id( tok, decode_basicquotedkey, end, branch, leaf );
+}
+
+toml_key_t*
+parse_literalquotedkey(
+    tokenizer_t*    tok,
+    token_type_t    end,
+    toml_key_type_t branch,
+    toml_key_type_t leaf
+) {
+    return parse_id( tok, decode_literalquotedkey, end, branch, leaf );
 }
 
 toml_key_t*
@@ -164,37 +183,35 @@ parse_key(
     bool         expecting
 ) {
     while( has_token( tok ) ) {
-        if( is_equal( get_token( tok ) ) ) {
+        if( get_token( tok )==TOKEN_EQUAL ) {
             RETURN_IF_FAILED( !expecting, "found = while expecting a key\n" );
             next_token( tok );
             return key;
         }
-        else if( is_dot( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_DOT ) {
             RETURN_IF_FAILED( !expecting, "found . while expecting a key\n" );
             next_token( tok );
             return parse_key( tok, key, true );
         }
-        else if( is_whitespace( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
             parse_whitespace( tok );
         }
-        else if( is_basicstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_basicquotedkey( tok, '=', TOML_KEY, TOML_KEYLEAF );
+        else if( get_token( tok )==TOKEN_BASICSTRING ) {
+            toml_key_t* subkey = parse_basicquotedkey( tok, TOKEN_EQUAL, TOML_KEY, TOML_KEYLEAF );
             RETURN_IF_FAILED( subkey, "failed to parse basic quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add subkey to key %s\n", key->id );
             return parse_key( tok, subkey, false );
         }
-        else if( is_literalstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_literalquotedkey( tok, '=', TOML_KEY, TOML_KEYLEAF );
+        else if( get_token( tok )==TOKEN_LITERALSTRING ) {
+            toml_key_t* subkey = parse_literalquotedkey( tok, TOKEN_EQUAL, TOML_KEY, TOML_KEYLEAF );
             RETURN_IF_FAILED( subkey, "failed to parse literal quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add subkey to key %s\n", key->id );
             return parse_key( tok, subkey, false );
         }
         else {
-            toml_key_t* subkey = parse_barekey( tok, '=', TOML_KEY, TOML_KEYLEAF );
+            toml_key_t* subkey = parse_barekey( tok, TOKEN_EQUAL, TOML_KEY, TOML_KEYLEAF );
             RETURN_IF_FAILED( subkey, "failed to parse bare key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add subkey to key %s\n", key->id );
@@ -211,37 +228,35 @@ parse_table(
     bool         expecting
 ) {
     while( has_token( tok ) ) {
-        if( is_tableend( get_token( tok ) ) ) {
+        if( get_token( tok )==TOKEN_RBRACKET ) {
             RETURN_IF_FAILED( !expecting, "found ] while expecting a key\n" );
             next_token( tok );
             return key;
         }
-        else if( is_dot( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_DOT ) {
             RETURN_IF_FAILED( !expecting, "found . while expecting a key\n" );
             next_token( tok );
             return parse_table( tok, key, true );
         }
-        else if( is_whitespace( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
             parse_whitespace( tok );
         }
-        else if( is_basicstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_basicquotedkey( tok, ']', TOML_TABLE, TOML_TABLELEAF );
+        else if( get_token( tok )==TOKEN_BASICSTRING ) {
+            toml_key_t* subkey = parse_basicquotedkey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_TABLELEAF );
             RETURN_IF_FAILED( subkey, "failed to parse basic quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
             return parse_table( tok, subkey, false );
         }
-        else if( is_literalstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_literalquotedkey( tok, ']', TOML_TABLE, TOML_TABLELEAF );
+        else if( get_token( tok )==TOKEN_LITERALSTRING ) {
+            toml_key_t* subkey = parse_literalquotedkey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_TABLELEAF );
             RETURN_IF_FAILED( subkey, "failed to parse literal quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
             return parse_table( tok, subkey, false );
         }
         else {
-            toml_key_t* subkey = parse_barekey( tok, ']', TOML_TABLE, TOML_TABLELEAF );
+            toml_key_t* subkey = parse_barekey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_TABLELEAF );
             RETURN_IF_FAILED( subkey, "failed to parse bare key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
@@ -258,39 +273,37 @@ parse_arraytable(
     bool         expecting
 ) {
     while( has_token( tok ) ) {
-        if( is_tableend( get_token( tok ) ) ) {
+        if( get_token( tok )==TOKEN_RBRACKET ) {
             RETURN_IF_FAILED( !expecting, "found ] while expecting a key\n" );
+            RETURN_IF_FAILED( peek( tok, 1 )==']', "expected ]] at end of array of tables\n" );
             next_token( tok );
-            RETURN_IF_FAILED( is_tableend( get_token( tok ) ), "found ] while expecting a key\n" );
             next_token( tok );
             return key;
         }
-        else if( is_dot( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_DOT ) {
             RETURN_IF_FAILED( !expecting, "found . while expecting a key\n" );
             next_token( tok );
             return parse_arraytable( tok, key, true );
         }
-        else if( is_whitespace( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
             parse_whitespace( tok );
         }
-        else if( is_basicstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_basicquotedkey( tok, ']', TOML_TABLE, TOML_ARRAYTABLE );
+        else if( get_token( tok )==TOKEN_BASICSTRING ) {
+            toml_key_t* subkey = parse_basicquotedkey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_ARRAYTABLE );
             RETURN_IF_FAILED( subkey, "failed to parse basic quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
             return parse_arraytable( tok, subkey, false );
         }
-        else if( is_literalstringstart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* subkey = parse_literalquotedkey( tok, ']', TOML_TABLE, TOML_ARRAYTABLE );
+        else if( get_token( tok )==TOKEN_LITERALSTRING ) {
+            toml_key_t* subkey = parse_literalquotedkey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_ARRAYTABLE );
             RETURN_IF_FAILED( subkey, "failed to parse literal quoted key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
             return parse_arraytable( tok, subkey, false );
         }
         else {
-            toml_key_t* subkey = parse_barekey( tok, ']', TOML_TABLE, TOML_ARRAYTABLE );
+            toml_key_t* subkey = parse_barekey( tok, TOKEN_RBRACKET, TOML_TABLE, TOML_ARRAYTABLE );
             RETURN_IF_FAILED( subkey, "failed to parse bare key\n" );
             subkey = add_subkey( key, subkey );
             RETURN_IF_FAILED( subkey, "failed to add key to subkey %s\n", key->id );
@@ -300,30 +313,133 @@ parse_arraytable(
     return NULL;
 }
 
+toml_key_t*
+add_arraytable_entry( toml_key_t* table ) {
+    if( table->value==NULL ) {
+        table->value = new_array();
+    }
+    RETURN_IF_FAILED( push_value( table->value, new_inline_table( new_key( TOML_TABLE ) ) ),
+                      "could not add entry to %s\n", table->id );
+    table->idx  = table->value->len-1;
+    return table;
+}
+
+static toml_key_t*
+add_path(
+    toml_key_t*        key,
+    const char* const* path,
+    int                depth,
+    toml_key_type_t    branch,
+    toml_key_type_t    leaf
+) {
+    for( int i=0; i<depth; i++ ) {
+        toml_key_t* subkey = new_key( i<depth-1 ? branch : leaf );
+        subkey->len        = strlen( path[ i ] );
+        subkey->id         = arena_strndup( current_arena, path[ i ], subkey->len );
+        toml_key_t* parent = key;
+        key = add_subkey( parent, subkey );
+        RETURN_IF_FAILED( key, "failed to add key to subkey %s\n", parent->id );
+    }
+    return key;
+}
+
+toml_key_t*
+add_table_path(
+    toml_key_t*        key,
+    const char* const* path,
+    int                depth,
+    bool               arraytable
+) {
+    key = add_path( key, path, depth, TOML_TABLE,
+                    arraytable ? TOML_ARRAYTABLE : TOML_TABLELEAF );
+    if( !key ) {
+        return NULL;
+    }
+    return arraytable ? add_arraytable_entry( key ) : key;
+}
+
+toml_key_t*
+add_inline_table(
+    toml_key_t*   key,
+    toml_value_t* v
+) {
+    // If we parsed an inlinetable, to keep it in sync
+    // with our datastructure, we add the keys from the
+    // parsed key-value pairs as `subkeys` of the "active"
+    // `key`. Since the inline table is defined as
+    // `a = b`, the type would be a KEYLEAF. Since KEYLEAF
+    // re-definitions are not allowed, we "unlock" it as a
+    // KEY, add the `subkeys` and "lock" it again as a
+    // `KEYLEAF` to prevent re-definition.
+    toml_key_t* h   = ( toml_key_t * )( v->data );
+    bool        ok  = true;
+    size_t      it  = 0;
+    toml_key_t* s;
+    key->type       = TOML_KEY;
+    while( ok && ( s=next_subkey( h, &it ) ) ) {
+        ok = add_subkey( key, s )!=NULL;
+    }
+    key->type       = TOML_KEYLEAF;
+    RETURN_IF_FAILED( ok, "could not add inline table keys to %s\n", key->id );
+    return key;
+}
+
+static bool
+set_value(
+    tokenizer_t* tok,
+    toml_key_t*  subkey
+) {
+    toml_value_t* v     = parse_value( tok );
+    RETURN_IF_FAILED( v, "failed to parse value\n" );
+    if( v->type==TOML_INLINETABLE ) {
+        toml_key_t* e   = add_inline_table( subkey, v );
+        RETURN_IF_FAILED( e, "could not add inline table %s\n", subkey->id );
+    }
+    else {
+        subkey->value   = v;
+    }
+    parse_whitespace( tok );
+    return true;
+}
+
+toml_key_t*
+parse_pathval(
+    tokenizer_t*       tok,
+    toml_key_t*        key,
+    const char* const* path,
+    int                depth
+) {
+    toml_key_t* subkey = add_path( key, path, depth, TOML_KEY, TOML_KEYLEAF );
+    RETURN_IF_FAILED( subkey, "failed to add key\n" );
+    return set_value( tok, subkey ) ? key : NULL;
+}
+
 toml_key_t*
 parse_keyval(
     tokenizer_t* tok,
     toml_key_t*  key,
     toml_key_t*  root
 ) {
-    if( is_commentstart( get_token( tok ) ) ) {
+    if( get_token( tok )==TOKEN_COMMENT ) {
         bool ok = parse_comment( tok );
         RETURN_IF_FAILED( ok, "invalid comment\n" );
         return key;
     }
-    else if( is_whitespace( get_token( tok ) ) ) {
+    else if( get_token( tok )==TOKEN_WHITESPACE ) {
         parse_whitespace( tok );
         return key;
     }
     else if( parse_newline( tok ) ) {
         next_token( tok );
+        tok->newline = true;
         return key;
     }
-    else if( is_tablestart( get_token( tok ) ) ) {
-        next_token( tok );
+    else if( get_token( tok )==TOKEN_LBRACKET ) {
+        tok->newline = false;
         toml_key_t* table;
         // [[ means we are parsing an arraytable
-        if( is_tablestart( get_token( tok ) ) ) {
+        if( peek( tok, 1 )=='[' ) {
+            next_token( tok );
             next_token( tok );
             table = parse_arraytable( tok, root, true );
             RETURN_IF_FAILED( table, "failed to parse array of tables\n" );
@@ -332,56 +448,27 @@ parse_keyval(
             // Each redefinition marks an new element in that array.
             // The key-value pairs are added to the `subkeys` of a
             // "pseudo" key that lives at `table->value->arr[ table->idx ].
-            if( table->value==NULL ) {
-                table->value = new_array();
-            }
-            RETURN_IF_FAILED( table->idx<TOML_MAX_ARRAY_LENGTH-1, "buffer overflow\n" );
-            table->value->arr[ ++( table->idx ) ] = new_inline_table( new_key( TOML_TABLE ) );
+            table = add_arraytable_entry( table );
+            RETURN_IF_FAILED( table, "failed to add to array of tables\n" );
         }
         else {
+            next_token( tok );
             table = parse_table( tok, root, true );
             RETURN_IF_FAILED( table, "failed to parse table\n" );
         }
         return table;
     }
-    else if( get_prev( tok )=='\0' ||
-             is_newline( get_prev( tok ) ) ||
-             // ignore white space found at the beginning of
-             // a line while parsing a key
-             ( is_whitespace( get_prev( tok ) ) &&
-             tok->newline ) ) {
+    // keys have to start on a new line, ignoring any
+    // white space found at the beginning of the line
+    else if( tok->newline ) {
+        tok->newline        = false;
         toml_key_t* subkey  = parse_key( tok, key, true );
         RETURN_IF_FAILED( subkey, "failed to parse key\n" );
-        toml_value_t* v     = parse_value( tok, "# \n" );
-        RETURN_IF_FAILED( v, "failed to parse value\n" );
-        // If we parsed an inlinetable, to keep it in sync
-        // with our datastructure, we add the keys from the
-        // parsed key-value pairs as `subkeys` of the "active"
-        // `key`. Since the inline table is defined as
-        // `a = b`, the type would be a KEYLEAF. Since KEYLEAF
-        // re-definitions are not allowed, we "unlock" it as a
-        // KEY, add the `subkeys` and "lock" it again as a
-        // `KEYLEAF` to prevent re-definition.
-        if( v->type==TOML_INLINETABLE ) {
-            toml_key_t* h   = ( toml_key_t * )( v->data );
-            subkey->type    = TOML_KEY;
-            for( khiter_t ki=kh_begin( h->subkeys );
-                 ki!=kh_end( h->subkeys );
-                 ++ki ) {
-                if( kh_exist( h->subkeys, ki ) ) {
-                    toml_key_t* e = add_subkey( subkey, kh_value( h->subkeys, ki ) );
-                    RETURN_IF_FAILED( e, "could not add inline table key %s\n", kh_value( h->subkeys, ki )->id );
-                }
-            }
-            subkey->type    = TOML_KEYLEAF;
-        }
-        else {
-            subkey->value   = v;
-        }
-        parse_whitespace( tok );
-        return key; 
+        return set_value( tok, subkey ) ? key : NULL;
     }
+    else if( get_token( tok )==TOKEN_INVALID )
+        LOG_ERR( "%s", tok->error );
     else
-        LOG_ERR( "unhandled character %c\n", get_token( tok ) );
+        LOG_ERR( "unexpected %.*s\n", ( int )get_length( tok ), get_text( tok ) );
     return NULL;
 }
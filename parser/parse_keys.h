@@ -7,21 +7,22 @@
     Functions `parse_barekey`, `parse_basicquotedkey`
     and `parse_literalquotedkey` parses a "bare key",
     a "basic quoted key" and a "literal quoted key"
-    respectively, as defined by the TOML spec. The caller
-    should decide which one is being parsed. They use `.`
-    and `=` as delimiters. Once it has successfully parsed
-    a key, it creates a key and returns a pointer to it.
-    All of them log errors and return NULL on parsing
-    failure. The key types `branch` and `leaf` passed as
-    arguments determine the key types of keys created upon
-    encountering a `.` and a `=` respectively. The `end`
-    argument determines which character marks the termination
-    of parsing.
+    respectively, as defined by the TOML spec, from the
+    current token. The caller should decide which one is
+    being parsed. They use `.` and `end` as delimiters.
+    Once it has successfully parsed a key, it creates a
+    key and returns a pointer to it, leaving the delimiter
+    as the current token. All of them log errors and
+    return NULL on parsing failure. The key types `branch`
+    and `leaf` passed as arguments determine the key types
+    of keys created upon encountering a `.` and an `end`
+    token respectively. The `id` of the key is decoded
+    into the current arena.
 */
 toml_key_t*
 parse_barekey(
     tokenizer_t*    tok,
-    char            end,
+    token_type_t    end,
     toml_key_type_t branch,
     toml_key_type_t leaf
 );
@@ -29,7 +30,7 @@ parse_barekey(
 toml_key_t*
 parse_basicquotedkey(
     tokenizer_t*    tok,
-    char            end,
+    token_type_t    end,
     toml_key_type_t branch,
     toml_key_type_t leaf
 );
@@ -37,11 +38,28 @@ parse_basicquotedkey(
 toml_key_t*
 parse_literalquotedkey(
     tokenizer_t*    tok,
-    char            end,
+    token_type_t    end,
     toml_key_type_t branch,
     toml_key_type_t leaf
 );
 
+/*
+    Function `parse_keyid` decodes the bare, basic quoted
+    or literal quoted key of the current token into `id`,
+    and moves on to the next token without creating a
+    key. The decoded key is never longer than the token,
+    so `id` has to hold `get_length( tok )+1` chars. The
+    decoded length, which escaped NULs are part of, is
+    stored in `len`. Returns false if the key could not
+    be decoded.
+*/
+bool
+parse_keyid(
+    tokenizer_t* tok,
+    char*        id,
+    size_t*      len
+);
+
 /*
     Functions `parse_key`, `parse_table` and
     `parse_arraytable` tries to parse a TOML
@@ -74,6 +92,58 @@ parse_arraytable(
     bool         expecting
 );
 
+/*
+    Function `add_arraytable_entry` starts a new entry in
+    the array of tables `table`, which the keys added to
+    `table` after it go into. Returns `table`, or NULL if
+    the array is full.
+*/
+toml_key_t*
+add_arraytable_entry( toml_key_t* table );
+
+/*
+    Function `add_table_path` adds the table header
+    `[path]`, or `[[path]]` if `arraytable` is set, with
+    `depth` already decoded parts to the `subkeys` of
+    `key`. It follows the same rules as `parse_table` and
+    `parse_arraytable`, and returns the table the keys
+    after the header go into or NULL on failure.
+*/
+toml_key_t*
+add_table_path(
+    toml_key_t*        key,
+    const char* const* path,
+    int                depth,
+    bool               arraytable
+);
+
+/*
+    Function `add_inline_table` adds the keys of the inline
+    table `v` to the `subkeys` of `key` and locks `key` as
+    a `KEYLEAF`.
+    Returns `key`, or NULL if a key could not be added.
+*/
+toml_key_t*
+add_inline_table(
+    toml_key_t*   key,
+    toml_value_t* v
+);
+
+/*
+    Function `parse_pathval` parses the value after the
+    `=` of a key-value pair whose dotted key was already
+    decoded into the `depth` parts of `path`, adding the
+    key to the `subkeys` of `key` like `parse_keyval`
+    does. Returns `key`, or NULL on failure.
+*/
+toml_key_t*
+parse_pathval(
+    tokenizer_t*       tok,
+    toml_key_t*        key,
+    const char* const* path,
+    int                depth
+);
+
 /*
     Function `parse_keyval` tries to parse a key
     and a value as defined by TOML. This is the entry
@@ -2,6 +2,10 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 bool
 is_whitespace( char c ) {
     return ( c==' ' || c=='\t' );
@@ -103,6 +107,41 @@ is_bare_ascii( char c ) {
     );
 }
 
+size_t
+span_plain(
+    const char* s,
+    size_t      n,
+    bool        escapes
+) {
+    size_t i    = 0;
+#ifdef __SSE2__
+    const __m128i ctrl  = _mm_set1_epi8( 0x1F );
+    const __m128i del   = _mm_set1_epi8( 0x7F );
+    const __m128i tab   = _mm_set1_epi8( '\t' );
+    const __m128i esc   = _mm_set1_epi8( escapes ? '\\' : 0x7F );
+    for( ; i+16<=n; i+=16 ) {
+        __m128i v   = _mm_loadu_si128( ( const __m128i* )( s+i ) );
+        // control characters are left unchanged by an
+        // unsigned max with 0x1F
+        __m128i m   = _mm_cmpeq_epi8( _mm_max_epu8( v, ctrl ), ctrl );
+        m           = _mm_andnot_si128( _mm_cmpeq_epi8( v, tab ), m );
+        m           = _mm_or_si128( m, _mm_cmpeq_epi8( v, del ) );
+        m           = _mm_or_si128( m, _mm_cmpeq_epi8( v, esc ) );
+        unsigned stop   = ( unsigned )_mm_movemask_epi8( m );
+        if( stop ) {
+            return i+__builtin_ctz( stop );
+        }
+    }
+#endif
+    for( ; i<n; i++ ) {
+        unsigned char c = s[ i ];
+        if( ( c<0x20 && c!='\t' ) || c==0x7F || ( escapes && c=='\\' ) ) {
+            break;
+        }
+    }
+    return i;
+}
+
 bool
 is_control( char c ) {
     return (
@@ -132,18 +171,6 @@ is_control_literal( char c ) {
     );
 }
 
-bool
-is_numberend(
-    char c,
-    const char* end
-) {
-    for( int i=0; i<strlen( end ); i++ )
-    {
-        if ( c==end[ i ] ) return true;
-    }
-    return false;
-}
-
 bool
 is_decimalpoint( char c ) {
     return ( c=='.' );
@@ -229,3 +256,36 @@ is_validdatetime( struct tm* datetime ) {
             is_date( datetime->tm_year+1900, datetime->tm_mon, datetime->tm_mday )
     );
 }
+
+int64_t
+days_from_civil(
+    int year,
+    int month,
+    int day
+) {
+    // years start in March, so the leap day comes last
+    year       -= ( month<=2 );
+    int64_t era = ( year>=0 ? year : year-399 )/400;
+    int64_t yoe = year-era*400;
+    int64_t doy = ( 153*( month>2 ? month-3 : month+9 )+2 )/5+day-1;
+    int64_t doe = yoe*365+yoe/4-yoe/100+doy;
+    return era*146097+doe-719468;
+}
+
+void
+civil_from_days(
+    int64_t days,
+    int*    year,
+    int*    month,
+    int*    day
+) {
+    days       += 719468;
+    int64_t era = ( days>=0 ? days : days-146096 )/146097;
+    int64_t doe = days-era*146097;
+    int64_t yoe = ( doe-doe/1460+doe/36524-doe/146096 )/365;
+    int64_t doy = doe-( 365*yoe+yoe/4-yoe/100 );
+    int64_t mp  = ( 5*doy+2 )/153;
+    *day        = ( int )( doy-( 153*mp+2 )/5+1 );
+    *month      = ( int )( mp<10 ? mp+3 : mp-9 );
+    *year       = ( int )( yoe+era*400+( *month<=2 ) );
+}
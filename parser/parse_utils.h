@@ -2,6 +2,8 @@
 #define __TOMLIBC_PARSE_UTILS_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 /*
@@ -39,8 +41,26 @@ bool is_basicstringstart  ( char c );
 bool is_inlinetablestart  ( char c );
 bool is_literalstringstart( char c );
 
+/*
+    Function `span_plain` returns the number of characters
+    at the start of the `n` characters of `s` that can be
+    copied into a string as they are, which is everything
+    but control characters other than tab and, if `escapes`
+    is set, backslashes. It looks at 16 characters at a time
+    where SSE2 is available.
+*/
+size_t span_plain( const char* s, size_t n, bool escapes );
+
 bool is_date( int year, int month, int day );
-bool is_numberend( char c, const char* end );
 bool is_validdatetime( struct tm* datetime );
 
+/*
+    Functions `days_from_civil` and `civil_from_days`
+    convert between a date, with months from 1 to 12, and
+    the number of days since 1970-01-01 in the proleptic
+    Gregorian calendar.
+*/
+int64_t days_from_civil( int year, int month, int day );
+void    civil_from_days( int64_t days, int* year, int* month, int* day );
+
 #endif
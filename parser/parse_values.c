@@ -5,552 +5,283 @@
 #include "lib/key.h"
 #include "lib/value.h"
 #include "lib/utils.h"
+#include "lib/decimal.h"
 
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <locale.h>
 
 char*
 parse_basicstring(
     tokenizer_t* tok,
     char*        value,
-    bool         multi
+    bool         multi,
+    size_t*      len
 ) {
-    int idx = 0;
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-        if( is_basicstringstart( get_token( tok ) ) ) {
-            if( !multi ) {
-                next_token( tok );
-                return value;
-            }
-            else {
-                int a = next_token( tok );
-                int b = next_token( tok );
-                if( is_basicstringstart( get_token( tok ) ) &&
-                    is_basicstringstart( get_prev( tok ) ) ) {
-                    next_token( tok );
-                    if( is_basicstringstart( get_token( tok ) ) ) {
-                        value[ idx++ ]  = '"';
-                        next_token( tok );
-                    }
-                    RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-                    if( is_basicstringstart( get_token( tok ) ) ) {
-                        value[ idx++ ]  = '"';
-                        next_token( tok );
-                    }
-                    return value;
-                }
-                else {
-                    value[ idx++ ]      = '"';
-                    backtrack( tok, a+b-1 );
-                    continue;
-                }
-            }
-        }
-        else if( parse_newline( tok ) && !multi ) {
-            LOG_ERR( "newline before end of string\n" );
-            break;
+    size_t      idx = 0;
+    const char* c   = get_text( tok );
+    const char* end = c+get_length( tok );
+    // a newline right after the opening delimiter is trimmed
+    if( multi && c<end && is_return( *c ) && c+1<end && is_newline( c[ 1 ] ) ) {
+        c += 2;
+    }
+    else if( multi && c<end && is_newline( *c ) ) {
+        c++;
+    }
+    while( c<end ) {
+        // copy everything up to the next escape or control
+        // character in one go
+        size_t run  = span_plain( c, end-c, true );
+        if( run ) {
+            memcpy( value+idx, c, run );
+            idx    += run;
+            c      += run;
+            continue;
         }
-        else if( parse_newline( tok ) && multi && idx==0 )
-            ;
-        else if( is_escape( get_token( tok ) ) ) {
-            next_token( tok );
+        if( is_escape( *c ) ) {
+            c++;
             char escaped[ 5 ] = { 0 };
-            int c             = parse_escape( tok, escaped, 5 );
-            if( multi && c==0 ) {
+            int n             = parse_escape( &c, end, escaped, 5 );
+            if( multi && n==0 ) {
+                // a line ending backslash trims all whitespace
+                // and newlines up to the next non-whitespace
                 bool hit    = false;
-                while( is_whitespace( get_token( tok ) ) ||
-                       parse_newline( tok ) ) {
-                    if( is_whitespace( get_token( tok ) ) ) {
-                        parse_whitespace( tok );
+                while( c<end ) {
+                    if( is_whitespace( *c ) ) {
+                        c++;
+                    }
+                    else if( is_newline( *c ) ) {
+                        hit = true;
+                        c++;
                     }
-                    if( parse_newline( tok ) ) {
+                    else if( is_return( *c ) && c+1<end && is_newline( c[ 1 ] ) ) {
                         hit = true;
-                        next_token( tok );
+                        c  += 2;
+                    }
+                    else {
+                        break;
                     }
                 }
                 RETURN_IF_FAILED( hit, "cannot have characters on same line after \\\n" );
                 continue;
             }
-            else {
-                RETURN_IF_FAILED( c!=0, "unknown escape sequence \\%c\n", get_token( tok ) );
-                RETURN_IF_FAILED( c<5,  "parsed escape sequence is too long\n" );
-                for( int i=0; i<c; i++ ) {
-                    value[ idx++ ] = escaped[i];
-                    RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-                }
-                // parse_escape will parse everything and move on to the next token
-                // so we call backtrack here to offset the next_token call outside
-                backtrack( tok, 1 );
-            }
+            RETURN_IF_FAILED( n!=0, "unknown escape sequence \\%c\n", c<end ? *c : ' ' );
+            RETURN_IF_FAILED( n<5,  "parsed escape sequence is too long\n" );
+            memcpy( value+idx, escaped, n );
+            idx    += n;
+            continue;
         }
-        else if( !multi && is_control( get_token( tok ) ) ) {
-            LOG_ERR( "control characters need to be escaped\n" );
-            break;
+        else if( multi && is_return( *c ) && c+1<end && is_newline( c[ 1 ] ) ) {
+            // \r\n is stored as \n
+            c++;
+            continue;
         }
-        else if( multi && is_control_multi( get_token( tok ) ) ) {
+        else if( !multi && is_control( *c ) ) {
             LOG_ERR( "control characters need to be escaped\n" );
-            break;
+            return NULL;
         }
-        else {
-            value[ idx++ ] = get_token( tok );
+        else if( multi && is_control_multi( *c ) ) {
+            LOG_ERR( "control characters need to be escaped\n" );
+            return NULL;
         }
-        next_token( tok );
+        value[ idx++ ] = *c++;
     }
-    return NULL;
+    value[ idx ]    = '\0';
+    *len            = idx;
+    next_token( tok );
+    return value;
 }
 
 char*
 parse_literalstring(
     tokenizer_t* tok,
     char*        value,
-    bool         multi
+    bool         multi,
+    size_t*      len
 ) {
-    int idx = 0;
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-        if( is_literalstringstart( get_token( tok ) ) ) {
-            if( !multi ) {
-                next_token( tok );
-                return value;
-            }
-            else {
-                int a = next_token( tok );
-                int b = next_token( tok );
-                if( is_literalstringstart( get_token( tok ) ) &&
-                    is_literalstringstart( get_prev( tok ) ) ) {
-                    next_token( tok );
-                    if( is_literalstringstart( get_token( tok ) ) ) {
-                        value[ idx++ ]  = '\'';
-                        next_token( tok );
-                    }
-                    RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-                    if( is_literalstringstart( get_token( tok ) ) ) {
-                        value[ idx++ ]  = '\'';
-                        next_token( tok );
-                    }
-                    return value;
-                }
-                else {
-                    value[ idx++ ]      = '\'';
-                    backtrack( tok, a+b-1 );
-                    continue;
-                }
-            }
+    size_t      idx = 0;
+    const char* c   = get_text( tok );
+    const char* end = c+get_length( tok );
+    // a newline right after the opening delimiter is trimmed
+    if( multi && c<end && is_return( *c ) && c+1<end && is_newline( c[ 1 ] ) ) {
+        c += 2;
+    }
+    else if( multi && c<end && is_newline( *c ) ) {
+        c++;
+    }
+    while( c<end ) {
+        size_t run  = span_plain( c, end-c, false );
+        if( run ) {
+            memcpy( value+idx, c, run );
+            idx    += run;
+            c      += run;
+            continue;
         }
-        else if( parse_newline( tok ) && !multi ) {
-            LOG_ERR( "newline before end of string\n" );
-            break;
+        if( multi && is_return( *c ) && c+1<end && is_newline( c[ 1 ] ) ) {
+            // \r\n is stored as \n
+            c++;
+            continue;
         }
-        else if( parse_newline( tok ) && multi && idx==0 )
+        else if( multi && is_newline( *c ) )
             ;
-        else if( is_control_literal( get_token( tok ) ) ) {
+        else if( is_control_literal( *c ) ) {
             LOG_ERR( "control characters need to be escaped\n" );
-            break;
-        }
-        else {
-            value[ idx++ ] = get_token( tok );
+            return NULL;
         }
-        next_token( tok );
+        value[ idx++ ] = *c++;
     }
-    return NULL;
+    value[ idx ]    = '\0';
+    *len            = idx;
+    next_token( tok );
+    return value;
 }
 
-datetime_t*
-parse_datetime(
-    tokenizer_t* tok,
-    char*        value,
-    const char*  num_end,
-    struct tm*   time
-) {
-    datetime_t* dt     = NULL;
-    int         idx    = 0;
-    // check to allow only 1 whitespace character
-    int         spaces = 0;
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-        if( ( is_whitespace( get_token( tok ) ) && spaces ) ||
-            ( !is_whitespace( get_token( tok ) ) && is_numberend( get_token( tok ), num_end ) )
-          ) {
-            int  millis       =   0  ;
-            char year   [ 5 ] = { 0 };
-            char mon    [ 3 ] = { 0 };
-            char mday   [ 3 ] = { 0 };
-            char hour   [ 3 ] = { 0 };
-            char min    [ 3 ] = { 0 };
-            char sec    [ 3 ] = { 0 };
-            char delim  [ 2 ] = { 0 };
-            char tz     [ 2 ] = { 0 };
-            char off_s  [ 2 ] = { 0 };
-            char off_h  [ 3 ] = { 0 };
-            char off_m  [ 3 ] = { 0 };
-
-            char*         end;
-            unsigned long num;
-            int           t;
-            #define CHECK_DATETIME( var, len, ... )                         \
-                do {                                                        \
-                    RETURN_IF_FAILED( strlen( var )==len, __VA_ARGS__ );    \
-                    num = strtoul( var, &end, 10 );                         \
-                    RETURN_IF_FAILED( end==var+len, __VA_ARGS__ );          \
-                } while( 0 )
-
-            #define CHECK_DATE()                                        \
-                do {                                                    \
-                    CHECK_DATETIME( year, 4, "invalid year\n" );        \
-                    time->tm_year   = num-1900;                         \
-                    CHECK_DATETIME( mon,  2, "invalid month\n" );       \
-                    time->tm_mon    =  num-1;                           \
-                    CHECK_DATETIME( mday, 2, "invalid day\n" );         \
-                    time->tm_mday   = num;                              \
-                } while( 0 )
-
-            #define CHECK_TIME()                                        \
-                do {                                                    \
-                    CHECK_DATETIME( hour, 2, "invalid hour\n" );        \
-                    time->tm_hour   = num;                              \
-                    CHECK_DATETIME( min,  2, "invalid minute\n" );      \
-                    time->tm_min    =  num;                             \
-                    CHECK_DATETIME( sec,  2, "invalid second\n" );      \
-                    time->tm_sec    =  num;                             \
-                } while( 0 )
-
-            // DATETIME with millisecond and offset
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c.%d%1c%2c:%2c",
-                        year, mon, mday, delim, hour, min, sec, &millis, off_s, off_h, off_m );
-            if( t==11 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( strlen( off_s )==1, "invalid offset sign\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( off_s[ 0 ]=='+' || off_s[ 0 ]=='-' ), "invalid offset sign\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified offset datetime is not valid\n" );
-
-                CHECK_DATETIME( off_h, 2, "invalid offset hour\n" );
-                RETURN_IF_FAILED( ( num>=0 && num<=23 ), "invalid offset hour\n" );
-                time->tm_gmtoff = num*60*60;
-                CHECK_DATETIME( off_m, 2, "invalid offset minute\n" );
-                RETURN_IF_FAILED( ( num>=0 && num<=59 ), "invalid offset minute\n" );
-                time->tm_gmtoff += num;
-                
-                if( off_s[ 0 ]=='-' ) {
-                    time->tm_gmtoff *= -1;
-                }
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                double mlen = floor( log10( abs( millis ) ) ) + 1;
-                if( mlen==1 ) millis *= 100;
-                if( mlen==2 ) millis *= 10;
-                
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SS.-HH:MM" )+mlen+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt         = calloc( 1, sizeof( datetime_t ) );
-                dt->type   = TOML_DATETIME;
-                dt->dt     = time;
-                mlen       = ( mlen>3 ) ? mlen : 3;
-                dt->millis = millis;
-                int sz     = strlen( "%Y-%m-%dT%H:%M:%S.-HH:MM" )+mlen+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c      = snprintf( dt->format, sz, "%%Y-%%m-%%dT%%H:%%M:%%S.%d%c%s:%s",
-                                        millis, off_s[ 0 ], off_h, off_m );
-                return dt;
-            }
-            // DATETIME with offset
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c%1c%2c:%2c",
-                        year, mon, mday, delim, hour, min, sec, off_s, off_h, off_m );
-            if( t==10 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( strlen( off_s )==1, "invalid offset sign\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( off_s[ 0 ]=='+' || off_s[ 0 ]=='-' ), "invalid offset sign\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified offset datetime is not valid\n" );
-
-                CHECK_DATETIME( off_h, 2, "invalid offset hour\n" );
-                RETURN_IF_FAILED( ( num>=0 && num<=23 ), "invalid offset hour\n" );
-                time->tm_gmtoff = num*60*60;
-                CHECK_DATETIME( off_m, 2, "invalid offset minute\n" );
-                RETURN_IF_FAILED( ( num>=0 && num<=59 ), "invalid offset minute\n" );
-                time->tm_gmtoff += num;
-
-                if( off_s[ 0 ]=='-' ) {
-                    time->tm_gmtoff *= -1;
-                }
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SS-HH:MM" )+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt       = calloc( 1, sizeof( datetime_t ) );
-                dt->type = TOML_DATETIME;
-                dt->dt   = time;
-                int sz   = strlen( "%Y-%m-%dT%H:%M:%S-HH:MM" )+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c    = snprintf( dt->format, sz, "%%Y-%%m-%%dT%%H:%%M:%%S%c%s:%s",
-                                     off_s[ 0 ], off_h, off_m );
-                return dt;
-            }
-            // DATETIME with millisecond and timezone
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c.%d%1c",
-                        year, mon, mday, delim, hour, min, sec, &millis, tz );
-            if( t==9 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( strlen( tz )==1, "invalid timezone\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( tz[ 0 ]=='Z' || tz[ 0 ]=='z' ), "invalid timezone\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified offset datetime is not valid\n" );
-
-                time->tm_zone = "UTC";
-
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                double mlen = floor( log10( abs( millis ) ) ) + 1;
-                if( mlen==1 ) millis *= 100;
-                if( mlen==2 ) millis *= 10;
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SS.Z" )+mlen+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt         = calloc( 1, sizeof( datetime_t ) );
-                dt->type   = TOML_DATETIME;
-                dt->dt     = time;
-                mlen       = ( mlen>3 ) ? mlen : 3;
-                dt->millis = millis;
-                int sz     = strlen( "%Y-%m-%dT%H:%M:%S.Z" )+mlen+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c      = snprintf( dt->format, sz, "%%Y-%%m-%%dT%%H:%%M:%%S.%dZ", millis );
-                return dt;
-            }
-            // DATETIMELOCAL with millisecond
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c.%d",
-                        year, mon, mday, delim, hour, min, sec, &millis );
-            if( t==8 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified local datetime is not valid\n" );
-
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                double mlen = floor( log10( abs( millis ) ) ) + 1;
-                if( mlen==1 ) millis *= 100;
-                if( mlen==2 ) millis *= 10;
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SS." )+mlen+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt         = calloc( 1, sizeof( datetime_t ) );
-                dt->type   = TOML_DATETIMELOCAL;
-                dt->dt     = time;
-                mlen       = ( mlen>3 ) ? mlen : 3;
-                dt->millis = millis;
-                int sz     = strlen( "%Y-%m-%dT%H:%M:%S." )+mlen+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c      = snprintf( dt->format, sz, "%%Y-%%m-%%dT%%H:%%M:%%S.%d", millis );
-                return dt;
-            }
-            // DATETIME with timezone
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c%1c",
-                        year, mon, mday, delim, hour, min, sec, tz );
-            if( t==8 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( strlen( tz )==1, "invalid timezone\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( tz[ 0 ]=='Z' || tz[ 0 ]=='z' ), "invalid timezone\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified offset datetime is not valid\n" );
-
-                time->tm_zone = "UTC";
-
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                double mlen = floor( log10( abs( millis ) ) ) + 1;
-                if( mlen==1 ) millis *= 100;
-                if( mlen==2 ) millis *= 10;
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SSZ" )+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt       = calloc( 1, sizeof( datetime_t ) );
-                dt->type = TOML_DATETIME;
-                dt->dt   = time;
-                int sz   = strlen( "%Y-%m-%dT%H:%M:%SZ" )+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c    = snprintf( dt->format, sz, "%%Y-%%m-%%dT%%H:%%M:%%SZ" );
-                return dt;
-            }
-            // DATETIMELOCAL
-            t = sscanf( value, "%4c-%2c-%2c%1c%2c:%2c:%2c",
-                        year, mon, mday, delim, hour, min, sec );
-            if( t==7 ) {
-                RETURN_IF_FAILED( strlen( delim )==1, "invalid delimiter\n" );
-                RETURN_IF_FAILED( ( delim[ 0 ]=='T' || delim[ 0 ]=='t' || delim[ 0 ]==' ' ), "invalid delimiter\n" );
-
-                CHECK_DATE();
-                CHECK_TIME();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified local datetime is not valid\n" );
-
-                if( delim[ 0 ]==' ' ) {
-                    spaces  = 0;
-                }
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DDTHH:MM:SS" )+spaces ) ),
-                                    "datetime has incorrect number of characters\n" );
-
-                dt       = calloc( 1, sizeof( datetime_t ) );
-                dt->type = TOML_DATETIMELOCAL;
-                dt->dt   = time;
-                int sz   = strlen( "%Y-%m-%dT%H:%M:%S" );
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                memcpy( dt->format, "%Y-%m-%dT%H:%M:%S", sz );
-                return dt;
-            }
-            // DATELOCAL
-            t = sscanf( value, "%4c-%2c-%2c",
-                        year, mon, mday );
-            if( t==3 ) {
-                CHECK_DATE();
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified local date is not valid\n" );
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "YYYY-mm-DD" )+spaces ) ),
-                                    "date has incorrect number of characters\n" );
-
-                dt       = calloc( 1, sizeof( datetime_t ) );
-                dt->type = TOML_DATELOCAL;
-                dt->dt   = time;
-                int sz   = strlen( "%Y-%m-%d" );
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                memcpy( dt->format, "%Y-%m-%d", sz );
-                return dt;
-            }
-            // TIMELOCAL with millisecond
-            t = sscanf( value, "%2c:%2c:%2c.%d",
-                        hour, min, sec, &millis );
-            if( t==4 ) {
-                CHECK_TIME();
-                time->tm_year = 0;
-                time->tm_mon  = 0;
-                time->tm_mday = 1;
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified local time is not valid\n" );
-
-                double mlen = floor( log10( abs( millis ) ) ) + 1;
-                if( mlen==1 ) millis *= 100;
-                if( mlen==2 ) millis *= 10;
-
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "HH:MM:SS." )+mlen+spaces ) ),
-                                    "time has incorrect number of characters\n" );
-
-                dt         = calloc( 1, sizeof( datetime_t ) );
-                dt->type   = TOML_TIMELOCAL;
-                dt->dt     = time;
-                mlen       = ( mlen>3 ) ? mlen : 3;
-                dt->millis = millis;
-                int sz     = strlen( "%H:%M:%S." )+mlen+1;
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                int c      = snprintf( dt->format, sz, "%%H:%%M:%%S.%d", millis );
-                return dt;
-            }
-            // TIMELOCAL
-            t = sscanf( value, "%2c:%2c:%2c",
-                        hour, min, sec );
-            if( t==3 ) {
-                CHECK_TIME();
-                time->tm_year = 0;
-                time->tm_mon  = 0;
-                time->tm_mday = 1;
-                RETURN_IF_FAILED( is_validdatetime( time ), "specified local time is not valid\n" );
+/*
+    Functions `parse_2digits` and `parse_4digits` convert a
+    field of 2 or 4 digits at `s`, checking and converting
+    all of them at once in one integer, and return -1 if
+    any of them is not a digit.
+*/
+static int
+parse_2digits( const char* s ) {
+    uint32_t v  = ( uint32_t )( unsigned char )s[ 0 ] |
+                  ( uint32_t )( unsigned char )s[ 1 ]<<8;
+    if( ( v&0xF0F0 )!=0x3030 || ( ( v+0x0606 )&0xF0F0 )!=0x3030 ) {
+        return -1;
+    }
+    v          -= 0x3030;
+    return ( int )( ( v*10+( v>>8 ) )&0xFF );
+}
 
-                RETURN_IF_FAILED( ( strlen( value )==( strlen( "HH:MM:SS" )+spaces ) ),
-                                    "time has incorrect number of characters\n" );
+static int
+parse_4digits( const char* s ) {
+    uint32_t v  = ( uint32_t )( unsigned char )s[ 0 ]     |
+                  ( uint32_t )( unsigned char )s[ 1 ]<<8  |
+                  ( uint32_t )( unsigned char )s[ 2 ]<<16 |
+                  ( uint32_t )( unsigned char )s[ 3 ]<<24;
+    if( ( v&0xF0F0F0F0 )!=0x30303030 ||
+        ( ( v+0x06060606 )&0xF0F0F0F0 )!=0x30303030 ) {
+        return -1;
+    }
+    v          -= 0x30303030;
+    v           = ( v*10+( v>>8 ) )&0x00FF00FF;
+    return ( int )( ( v*100+( v>>16 ) )&0x3FFF );
+}
 
-                dt       = calloc( 1, sizeof( datetime_t ) );
-                dt->type = TOML_TIMELOCAL;
-                dt->dt   = time;
-                int sz   = strlen( "%H:%M:%S" );
-                FUNC_IF_FAILED(   sz<TOML_MAX_DATE_FORMAT, free, dt );
-                RETURN_IF_FAILED( sz<TOML_MAX_DATE_FORMAT, "datetime string is too long" );
-                memcpy( dt->format, "%H:%M:%S", sz );
-                return dt;
-            }
-            #undef CHECK_TIME
-            #undef CHECK_DATE
-            #undef CHECK_DATETIME
-            LOG_ERR( "could not parse %s as datetime\n", value );
-            break;
+toml_datetime_t*
+parse_datetime(
+    tokenizer_t*     tok,
+    toml_datetime_t* dt
+) {
+    const char* s       = get_text( tok );
+    size_t      len     = get_length( tok );
+    size_t      i       = 0;
+    struct tm   time    = { 0 };
+    bool        date    = !( len>2 && s[ 2 ]==':' );
+    bool        clock   = !date;
+    memset( dt, 0, sizeof( toml_datetime_t ) );
+    if( date ) {
+        RETURN_IF_FAILED( len>=10 && s[ 4 ]=='-' && s[ 7 ]=='-',
+                          "date has incorrect number of characters\n" );
+        int year        = parse_4digits( s );
+        int mon         = parse_2digits( s+5 );
+        int mday        = parse_2digits( s+8 );
+        RETURN_IF_FAILED( year>=0 && mon>=0 && mday>=0, "invalid date\n" );
+        time.tm_year    = year-1900;
+        time.tm_mon     = mon-1;
+        time.tm_mday    = mday;
+        i               = 10;
+        if( i<len ) {
+            RETURN_IF_FAILED( s[ i ]=='T' || s[ i ]=='t' || s[ i ]==' ',
+                              "invalid delimiter\n" );
+            clock       = true;
+            i++;
         }
-        else {
-            if( is_whitespace( get_token( tok ) ) ) {
-                spaces++;
-            }
-            value[ idx++ ] = get_token( tok );
+    }
+    else {
+        time.tm_year    = 0;
+        time.tm_mon     = 0;
+        time.tm_mday    = 1;
+    }
+    if( clock ) {
+        RETURN_IF_FAILED( len-i>=8 && s[ i+2 ]==':' && s[ i+5 ]==':',
+                          "time has incorrect number of characters\n" );
+        int hour        = parse_2digits( s+i );
+        int min         = parse_2digits( s+i+3 );
+        int sec         = parse_2digits( s+i+6 );
+        RETURN_IF_FAILED( hour>=0 && min>=0 && sec>=0, "invalid time\n" );
+        time.tm_hour    = hour;
+        time.tm_min     = min;
+        time.tm_sec     = sec;
+        i              += 8;
+        if( i<len && s[ i ]=='.' ) {
+            // digits past nanoseconds are truncated
+            size_t start    = ++i;
+            while( i<len && is_digit( s[ i ] ) ) {
+                i++;
+            }
+            size_t digits   = i-start;
+            RETURN_IF_FAILED( digits>0, "expected digits after the decimal point\n" );
+            for( size_t j=0; j<9; j++ ) {
+                dt->nanos   = dt->nanos*10+( j<digits ? s[ start+j ]-'0' : 0 );
+            }
+            dt->digits      = ( digits<9 ) ? digits : 9;
         }
-        next_token( tok );
     }
-    return NULL;
+    RETURN_IF_FAILED( is_validdatetime( &time ), "specified datetime is not valid\n" );
+    if( date && clock && i<len ) {
+        if( s[ i ]=='Z' || s[ i ]=='z' ) {
+            i++;
+        }
+        else {
+            RETURN_IF_FAILED( ( s[ i ]=='+' || s[ i ]=='-' ) && len-i>=6 && s[ i+3 ]==':',
+                              "invalid offset\n" );
+            int off_h       = parse_2digits( s+i+1 );
+            int off_m       = parse_2digits( s+i+4 );
+            RETURN_IF_FAILED( off_h>=0 && off_h<=23, "invalid offset hour\n" );
+            RETURN_IF_FAILED( off_m>=0 && off_m<=59, "invalid offset minute\n" );
+            dt->offset      = ( s[ i ]=='-' ? -1 : 1 )*( off_h*60+off_m );
+            i              += 6;
+        }
+        dt->kind        = TOML_DATETIME;
+    }
+    else {
+        dt->kind        = !date  ? TOML_TIMELOCAL :
+                          !clock ? TOML_DATELOCAL : TOML_DATETIMELOCAL;
+    }
+    RETURN_IF_FAILED( i==len, "datetime has incorrect number of characters\n" );
+    dt->epoch           = time.tm_hour*60*60+time.tm_min*60+time.tm_sec-dt->offset*60;
+    if( date ) {
+        dt->epoch      += days_from_civil( time.tm_year+1900, time.tm_mon+1,
+                                           time.tm_mday )*24*60*60;
+    }
+    next_token( tok );
+    return dt;
 }
 
 double
 parse_inf_nan(
-    tokenizer_t* tok,
-    bool         negative
+    const char* s,
+    size_t      len
 ) {
-    double ret = 0.0;
-    if( get_token( tok )=='i' ) {
-        next_token( tok );
-        next_token( tok );
-        if( get_prev( tok )=='n' && get_token( tok )=='f' ) {
-            if( negative ) {
-                ret = ( double )-INFINITY;
-            }
-            else {
-                ret = ( double )INFINITY;
-            }
-        }
+    double ret      = 0.0;
+    bool   negative = false;
+    if( len==4 && ( s[ 0 ]=='+' || s[ 0 ]=='-' ) ) {
+        negative    = ( s[ 0 ]=='-' );
+        s++;
+        len--;
     }
-    if( get_token( tok )=='n' ) {
-        next_token( tok );
-        next_token( tok );
-        if( get_prev( tok )=='a' && get_token( tok )=='n' ) {
-            if( negative ) {
-                ret = ( double )-NAN;
-            }
-            else {
-                ret = ( double )NAN;
-            }
-        }
+    if( len!=3 ) {
+        return ret;
+    }
+    if( memcmp( s, "inf", 3 )==0 ) {
+        ret = negative ? ( double )-INFINITY : ( double )INFINITY;
+    }
+    else if( memcmp( s, "nan", 3 )==0 ) {
+        ret = negative ? ( double )-NAN : ( double )NAN;
     }
-    next_token( tok );
     return ret;
 }
 
@@ -561,12 +292,11 @@ parse_array(
 ) {
     bool sep = true;
     while( has_token( tok ) ) {
-        RETURN_IF_FAILED( arr->len<TOML_MAX_ARRAY_LENGTH, "buffer overflow\n" );
-        if( is_arrayend( get_token( tok ) ) ) {
+        if( get_token( tok )==TOKEN_RBRACKET ) {
             next_token( tok );
             return arr;
         }
-        else if( is_arraysep( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_COMMA ) {
             RETURN_IF_FAILED( !sep, "expected value but got , instead\n" );
             sep = true;
             next_token( tok );
@@ -574,58 +304,33 @@ parse_array(
         else if( parse_newline( tok ) ) {
             next_token( tok );
         }
-        else if( is_whitespace( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
             parse_whitespace( tok );
         }
-        else if( is_commentstart( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_COMMENT ) {
             bool ok = parse_comment( tok );
             RETURN_IF_FAILED( ok, "invalid comment\n" );
         }
         else {
             RETURN_IF_FAILED( sep, "expected , between elements\n" );
-            toml_value_t* v = parse_value( tok, "#,] \n" );
+            toml_value_t* v = parse_value( tok );
             RETURN_IF_FAILED( v, "could not parse value\n" );
-            arr->arr[ arr->len++ ] = v;
+            RETURN_IF_FAILED( push_value( arr, v ), "could not add value\n" );
             sep = false;
         }
     }
     return NULL;
 }
 
-double
-parse_boolean( tokenizer_t* tok ) {
-    double ret = 2.0;
-    if( get_token( tok )=='t' ) {
-        next_token( tok );
-        next_token( tok );
-        next_token( tok );
-        if( get_prev_prev( tok )!='r' ||
-            get_prev( tok )!='u' ||
-            get_token( tok )!='e' ) {
-            ret = 2.0;
-        }
-        else {
-            ret = 1.0;
-        }
-    }
-    else if( get_token( tok )=='f' ) {
-        next_token( tok );
-        next_token( tok );
-        next_token( tok );
-        if( get_prev_prev( tok )!='a' ||
-            get_prev( tok )!='l' ||
-            get_token( tok )!='s' ) {
-            ret = 2.0;
-        }
-        else {
-            next_token( tok );
-            if( get_token( tok )=='e' ) {
-                ret = 0.0;
-            }
-        }
-    }
+bool*
+parse_boolean(
+    tokenizer_t* tok,
+    bool*        b
+) {
+    RETURN_IF_FAILED( get_token( tok )==TOKEN_BOOL, "expecting true or false\n" );
+    *b  = ( get_text( tok )[ 0 ]=='t' );
     next_token( tok );
-    return ret;
+    return b;
 }
 
 toml_key_t*
@@ -634,14 +339,12 @@ parse_inlinetable( tokenizer_t* tok ) {
     bool        sep   = true;
     bool        first = true;
     while( has_token( tok ) ) {
-        if( is_inlinetableend( get_token( tok ) ) ) {
-            FUNC_IF_FAILED(   ( !sep || first ), delete_key, keys );
+        if( get_token( tok )==TOKEN_RBRACE ) {
             RETURN_IF_FAILED( ( !sep || first ), "cannot have trailing comma in inline table\n" );
             next_token( tok );
             return keys;
         }
-        else if( is_inlinetablesep( get_token( tok ) ) ) {
-            FUNC_IF_FAILED(   !sep, delete_key, keys );
+        else if( get_token( tok )==TOKEN_COMMA ) {
             RETURN_IF_FAILED( !sep, "expected key-value but got , instead" );
             sep = true;
             next_token( tok );
@@ -650,32 +353,18 @@ parse_inlinetable( tokenizer_t* tok ) {
             LOG_ERR( "found newline in inline table\n" );
             break;
         }
-        else if( is_whitespace( get_token( tok ) ) ) {
+        else if( get_token( tok )==TOKEN_WHITESPACE ) {
             parse_whitespace( tok );
         }
         else {
-            FUNC_IF_FAILED(   sep, delete_key, keys );
             RETURN_IF_FAILED( sep, "expected , between elements\n" );
             toml_key_t*       k = parse_key( tok, keys, true );
-            FUNC_IF_FAILED(   k,  delete_key, keys );
             RETURN_IF_FAILED( k,  "failed to parse key\n" );
-            toml_value_t*     v = parse_value( tok, ", }" );
-            FUNC_IF_FAILED(   v,  delete_key, keys );
+            toml_value_t*     v = parse_value( tok );
             RETURN_IF_FAILED( v,  "failed to parse value\n" );
-            // refer to inline table comment in `keys.c`
             if( v->type==TOML_INLINETABLE ) {
-                toml_key_t* h = ( toml_key_t * )( v->data );
-                k->type       = TOML_KEY;
-                for( khiter_t ki=kh_begin( h->subkeys );
-                     ki!=kh_end( h->subkeys );
-                     ++ki ) {
-                    if( kh_exist( h->subkeys, ki ) ) {
-                        toml_key_t* e = add_subkey( k, kh_value( h->subkeys, ki ) );
-                        FUNC_IF_FAILED(   e,  delete_key, keys );
-                        RETURN_IF_FAILED( e, "could not add inline table key %s\n", kh_value( h->subkeys, ki )->id );
-                    }
-                }
-                k->type = TOML_KEYLEAF;
+                toml_key_t* e = add_inline_table( k, v );
+                RETURN_IF_FAILED( e, "could not add inline table\n" );
             }
             else {
                 k->value = v;
@@ -690,133 +379,104 @@ parse_inlinetable( tokenizer_t* tok ) {
 
 bool
 parse_comment( tokenizer_t* tok ) {
-    while( has_token( tok ) ) {
-        next_token( tok );
-        if( parse_newline( tok ) ) {
-            next_token( tok );
-            return true;
-        }
-        if( is_control( get_token( tok ) ) ) {
-            return false;
-        }
+    // the tokenizer already rejected control characters
+    if( get_token( tok )!=TOKEN_COMMENT ) {
+        return false;
     }
+    next_token( tok );
     return true;
 }
 
 void
 parse_whitespace( tokenizer_t* tok ) {
-    while( has_token( tok ) ) {
-        if( !is_whitespace( get_token( tok ) ) ) {
-            break;
-        }
+    // a run of whitespace is a single token
+    if( get_token( tok )==TOKEN_WHITESPACE ) {
         next_token( tok );
     }
 }
 
 bool
 parse_newline( tokenizer_t* tok ) {
-    if( is_newline( get_token( tok ) ) ) {
-        return true;
-    }
-    else if( is_return( get_token( tok ) ) ) {
-        bool a = next_token( tok );
-        if( is_newline( get_token( tok ) ) ) {
-            return true;
-        }
-        else {
-            backtrack( tok, a );
-        }
-    }
-    return false;
+    return get_token( tok )==TOKEN_NEWLINE;
 }
 
 int
 parse_unicode(
-    tokenizer_t* tok,
+    const char** c,
+    const char*  end,
+    int          digits,
     char*        escaped,
     int          len
 )
 {
-    int  digits    = 0;
     char code[ 9 ] = { 0 };
-    while( has_token( tok ) ) {
-        if( digits>8 ) {
+    if( end-*c<digits ) {
+        LOG_ERR( "Invalid unicode escape code\n" );
+        return 0;
+    }
+    for( int i=0; i<digits; i++ ) {
+        if( !is_hexdigit( ( *c )[ i ] ) && !is_digit( ( *c )[ i ] ) ) {
             LOG_ERR( "Invalid unicode escape code\n" );
-            break;
-        }
-        if( is_hexdigit( get_token( tok ) ) ||
-            is_digit( get_token( tok ) ) ) {
-            code[ digits++ ] = get_token( tok );
-            next_token( tok );
-            continue;
+            return 0;
         }
-        else {
-            if( digits!=4 && digits!=8 ) {
-                LOG_ERR( "Invalid unicode escape code\n" );
-                break;
+        code[ i ] = ( *c )[ i ];
+    }
+    unsigned long num = strtoul( code, NULL, 16 );
+    // Unicode Scalar Values: %x80-D7FF / %xE000-10FFFF
+    if( ( num>=0x0 && num<=0xD7FF ) || ( num>=0xE000 && num<=0x10FFFF ) ) {
+        // UTF-8 encoding
+        if( num>=0x0 && num<=0x7F ) {
+            if( len<1 ) {
+                LOG_ERR( "escaped array is not long enough\n" );
+                return 0;
             }
-            char*         end;
-            unsigned long num = strtoul( code, &end, 16 );
-            if( end!=code+digits ) {
-                LOG_ERR( "Invalid unicode escape code\n" );
-                break;
+            escaped[ 0 ] = ( num ) & 0b01111111;
+            *c += digits;
+            return 1;
+        }
+        else if( num>=0x80 && num<=0x7FF ) {
+            if( len<2 ) {
+                LOG_ERR( "escaped array is not long enough\n" );
+                return 0;
             }
-            // Unicode Scalar Values: %x80-D7FF / %xE000-10FFFF
-            if( ( num>=0x0 && num<=0xD7FF ) || ( num>=0xE000 && num<=0x10FFFF ) ) {
-                // UTF-8 encoding
-                if( num>=0x0 && num<=0x7F ) {
-                    if( len<1 ) {
-                        LOG_ERR( "escaped array is not long enough\n" );
-                        break;
-                    }
-                    escaped[ 0 ] = ( num ) & 0b01111111;
-                    return 1;
-                }
-                else if( num>=0x80 && num<=0x7FF ) {
-                    if( len<2 ) {
-                        LOG_ERR( "escaped array is not long enough\n" );
-                        break;
-                    }
-                    escaped[ 0 ] = ( 0b11000000 | ( num >> 6 ) )  & 0b11011111;
-                    escaped[ 1 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
-                    return 2;
-                }
-                else if( ( num>=0x800 && num<=0xFFFF ) ) {
-                    if( len<3 ) {
-                        LOG_ERR( "escaped array is not long enough\n" );
-                        break;
-                    }
-                    escaped[ 0 ] = ( 0b11100000 | ( num >> 12 ) ) & 0b11101111;
-                    escaped[ 1 ] = ( 0b10000000 | ( num >> 6 ) )  & 0b10111111;
-                    escaped[ 2 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
-                    return 3;
-                }
-                else
-                {
-                    if( len<4 ) {
-                        LOG_ERR( "escaped array is not long enough\n" );
-                        break;
-                    }
-                    escaped[ 0 ] = ( 0b11110000 | ( num >> 18 ) ) & 0b11110111;
-                    escaped[ 1 ] = ( 0b10000000 | ( num >> 12 ) ) & 0b10111111;
-                    escaped[ 2 ] = ( 0b10000000 | ( num >> 6 ) )  & 0b10111111;
-                    escaped[ 3 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
-                    return 4;
-                }
+            escaped[ 0 ] = ( 0b11000000 | ( num >> 6 ) )  & 0b11011111;
+            escaped[ 1 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
+            *c += digits;
+            return 2;
+        }
+        else if( ( num>=0x800 && num<=0xFFFF ) ) {
+            if( len<3 ) {
+                LOG_ERR( "escaped array is not long enough\n" );
                 return 0;
             }
-            else {
-                LOG_ERR( "Invalid unicode escape code\n" );
-                break;
+            escaped[ 0 ] = ( 0b11100000 | ( num >> 12 ) ) & 0b11101111;
+            escaped[ 1 ] = ( 0b10000000 | ( num >> 6 ) )  & 0b10111111;
+            escaped[ 2 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
+            *c += digits;
+            return 3;
+        }
+        else
+        {
+            if( len<4 ) {
+                LOG_ERR( "escaped array is not long enough\n" );
+                return 0;
             }
+            escaped[ 0 ] = ( 0b11110000 | ( num >> 18 ) ) & 0b11110111;
+            escaped[ 1 ] = ( 0b10000000 | ( num >> 12 ) ) & 0b10111111;
+            escaped[ 2 ] = ( 0b10000000 | ( num >> 6 ) )  & 0b10111111;
+            escaped[ 3 ] = ( 0b10000000 | ( num ) )       & 0b10111111;
+            *c += digits;
+            return 4;
         }
     }
+    LOG_ERR( "Invalid unicode escape code\n" );
     return 0;
 }
 
 int
 parse_escape(
-    tokenizer_t* tok,
+    const char** c,
+    const char*  end,
     char*        escaped,
     int          len
 ) {
@@ -824,51 +484,56 @@ parse_escape(
         LOG_ERR( "escaped array is not long enough\n" );
         return 0;
     }
-    switch ( get_token( tok ) ) {
+    if( *c>=end ) {
+        return 0;
+    }
+    switch ( **c ) {
         case 'b': {
             escaped[ 0 ]  = '\b';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case 't': {
             escaped[ 0 ]  = '\t';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case 'n': {
             escaped[ 0 ]  = '\n';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case 'f': {
             escaped[ 0 ]  = '\f';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case 'r': {
             escaped[ 0 ]  = '\r';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case '"': {
             escaped[ 0 ]  = '\"';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case '\\': {
             escaped[ 0 ]  = '\\';
-            next_token( tok );
+            ( *c )++;
             return 1;
         }
         case 'u': {
-            next_token( tok );
-            int u        = parse_unicode( tok, escaped, len );
-            return u;
+            const char* u = *c+1;
+            int n         = parse_unicode( &u, end, 4, escaped, len );
+            if( n ) *c    = u;
+            return n;
         }
         case 'U': {
-            next_token( tok );
-            int u        = parse_unicode( tok, escaped, len );
-            return u;
+            const char* u = *c+1;
+            int n         = parse_unicode( &u, end, 8, escaped, len );
+            if( n ) *c    = u;
+            return n;
         }
         default:
             return 0;
@@ -876,313 +541,279 @@ parse_escape(
     return 0;
 }
 
-double
+bool
 parse_base_uint(
-    tokenizer_t* tok,
-    int          base,
-    char*        value,
-    const char*  num_end
+    const char* s,
+    size_t      len,
+    int         base,
+    int64_t*    i
 ) {
-    int    idx = 0;
-    double d   = -1;
-    while( has_token( tok ) ) {
-        if( idx>=TOML_MAX_STRING_LENGTH ) {
-            LOG_ERR( "buffer overflow\n" );
-            break;
-        }
-        if( is_numberend( get_token( tok ), num_end ) ) {
-            if( idx==0 ) {
-                LOG_ERR( "incomplete non-decimal number\n" );
-                break;
-            }
-            char*         end;
-            unsigned long num = strtoul( value, &end, base );
-            if( end==value+idx ) {
-                d = ( double )num;
+    uint64_t u = 0;
+    if( len==0 ) {
+        LOG_ERR( "incomplete non-decimal number\n" );
+        return false;
+    }
+    for( size_t j=0; j<len; j++ ) {
+        char c = s[ j ];
+        if( is_underscore( c ) ) {
+            // underscores have to be surrounded by digits
+            if( j==0 || j+1==len ||
+                is_underscore( s[ j-1 ] ) || is_underscore( s[ j+1 ] ) ) {
+                LOG_ERR( "stray %c character\n", c );
+                return false;
             }
-            else {
-                LOG_ERR( "could not convert %s to base %d\n", value, base );
+            continue;
+        }
+        int digit = is_digit( c ) ? c-'0' :
+                    ( base==16 && is_hexdigit( c ) ) ? ( c|0x20 )-'a'+10 : base;
+        if( digit>=base ) {
+            LOG_ERR( "could not convert %.*s to base %d\n", ( int )len, s, base );
+            return false;
+        }
+        if( u>( ( uint64_t )INT64_MAX-digit )/base ) {
+            LOG_ERR( "%.*s does not fit in 64 bits\n", ( int )len, s );
+            return false;
+        }
+        u = u*base+digit;
+    }
+    *i = ( int64_t )u;
+    return true;
+}
+
+/*
+    Function `scan_digits` reads the digits from `s[ *i ]` on
+    and the underscores between them into `dec`, as many as
+    fit in its mantissa, marking it truncated if a digit
+    that is not zero is left out. It stores how many digits
+    were added in `kept` and returns how many were read, or
+    -1 on a stray underscore.
+*/
+static int
+scan_digits(
+    const char* s,
+    size_t      len,
+    size_t*     i,
+    decimal_t*  dec,
+    int*        kept
+) {
+    int digits  = 0;
+    *kept       = 0;
+    for( ; *i<len; ( *i )++ ) {
+        char c  = s[ *i ];
+        if( is_underscore( c ) ) {
+            // underscores have to be surrounded by digits
+            if( digits==0 || *i+1==len || !is_digit( s[ *i+1 ] ) ) {
+                LOG_ERR( "stray %c character\n", c );
+                return -1;
             }
+            continue;
+        }
+        if( !is_digit( c ) ) {
             break;
         }
-        else if( is_underscore( get_token( tok ) ) ) {
-            next_token( tok );
-            if( ( is_digit( get_token( tok ) ) ||
-                ( base==16 && is_hexdigit( get_token( tok ) ) ) ) &&
-                ( is_digit( get_prev_prev( tok ) ) ||
-                ( base==16 && is_hexdigit( get_prev_prev( tok ) ) ) ) ) {
-                value[ idx++ ] = get_token( tok );
-            }
-            else {
-                LOG_ERR( "stray %c character\n", get_prev( tok ) );
-                break;
-            }
+        if( dec->mantissa<=( UINT64_MAX-9 )/10 ) {
+            dec->mantissa   = dec->mantissa*10+( c-'0' );
+            ( *kept )++;
         }
-        else {
-            value[ idx++ ] = get_token( tok );
+        else if( c!='0' ) {
+            dec->truncated  = true;
+        }
+        digits++;
+    }
+    return digits;
+}
+
+/*
+    Function `parse_float_slow` converts the floats that
+    `decimal_to_double` cannot, with `strtod` on a copy
+    without underscores, using the decimal point of the
+    current locale.
+*/
+static bool
+parse_float_slow(
+    const char* s,
+    size_t      len,
+    double*     d
+) {
+    char* value = malloc( len+1 );
+    if( !value ) {
+        LOG_ERR( "could not allocate float\n" );
+        return false;
+    }
+    size_t idx  = 0;
+    for( size_t i=0; i<len; i++ ) {
+        if( is_decimalpoint( s[ i ] ) ) {
+            value[ idx++ ]  = localeconv()->decimal_point[ 0 ];
+        }
+        else if( !is_underscore( s[ i ] ) ) {
+            value[ idx++ ]  = s[ i ];
         }
-        next_token( tok );
     }
-    return d;
+    value[ idx ]    = '\0';
+    char* end;
+    *d          = strtod( value, &end );
+    bool  ok    = ( end==value+idx );
+    free( value );
+    return ok;
 }
 
 number_t*
 parse_number(
     tokenizer_t* tok,
-    char*        value,
     double*      d,
-    const char*  num_end,
     number_t*    n
 ) {
-    int         idx = 0;
+    const char* s   = get_text( tok );
+    size_t      len = get_length( tok );
     n->type         = TOML_INT;
+    n->integer      = 0;
     n->scientific   = false;
     n->precision    = 0;
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-        if( is_numberend( get_token( tok ), num_end ) ) {
-            char*   end;
-            double  num = strtod( value, &end );
-            RETURN_IF_FAILED( end==value+idx, "could not convert %s to double\n", value );
-            *d = num;
-            if( n->precision>0 ) n->precision--;
-            if( n->type==TOML_INT && num!=0 ) {
-                RETURN_IF_FAILED( value[ 0 ]!='0', "cannot have leading zero for integers" );
-                if( value[ 0 ]=='+' || value[ 0 ]=='-' ) {
-                    RETURN_IF_FAILED( value[ 1 ]!='0', "cannot have leading zero for signed integers" );
-                }
-            }
-            return n;
-        }
-        else if( idx==0 && get_token( tok )=='0' ) {
-            double b;
-            next_token( tok );
-            if( get_token( tok )=='x' ) {
-                // hexadecimal
-                next_token( tok );
-                b = parse_base_uint( tok, 16, value, num_end );
-            }
-            else if( get_token( tok )=='o' ) {
-                // octal
-                next_token( tok );
-                b = parse_base_uint( tok, 8,  value, num_end );
-            }
-            else if( get_token( tok )=='b' ) {
-                // binary
-                next_token( tok );
-                b = parse_base_uint( tok, 2,  value, num_end );
-            }
-            else {
-                value[ idx++ ] = '0';
-                continue;
-            }
-            RETURN_IF_FAILED( b!=-1, "invalid non-decimal number\n" );
-            *d = b;
-            return n;
-        }
-        else if( is_decimalpoint( get_token( tok ) ) ||
-                 is_underscore( get_token( tok ) ) ) {
-            if( is_decimalpoint( get_token( tok ) ) ) {
-                value[ idx++ ]  = get_token( tok );
-                n->type         = TOML_FLOAT;
-                n->precision    = 1;
-            }
-            RETURN_IF_FAILED( idx<TOML_MAX_STRING_LENGTH, "buffer overflow\n" );
-            next_token( tok );
-            if( is_digit( get_token( tok ) ) &&
-                is_digit( get_prev_prev( tok ) ) ) {
-                if( n->precision>0 ) n->precision++;
-                value[ idx++ ]  = get_token( tok );
-            }
-            else {
-                LOG_ERR( "stray %c character\n", get_prev( tok ) );
-                return NULL;
-            }
-        }
-        else if( get_token( tok )=='i' || get_token( tok )=='n' ) {
-            if( idx==1 && ( get_prev( tok )=='+' || get_prev( tok )=='-') ) {
-                double f     = parse_inf_nan( tok, ( get_prev( tok )=='-' ) );
-                if( f==0 ) break;
-                *d           = f;
-                n->type      = TOML_FLOAT;
-                n->precision = 0;
-                return n;
-            }
-            else {
-                LOG_ERR( "unknown or invalid number\n" );
-                return NULL;
-            }
-        }
-        else if( get_token( tok )=='x' || get_token( tok )=='X' ||
-                 get_token( tok )=='b' || get_token( tok )=='B' ||
-                 get_token( tok )=='o' || get_token( tok )=='O' ) {
-            LOG_ERR( "invalid decimal number, found stray character %c\n", get_token( tok ) );
-            break;
-        }
-        else {
-            value[ idx++ ]    = get_token( tok );
-            if( n->precision>0 ) n->precision++;
-            if( get_token( tok )=='e' || get_token( tok )=='E' ) {
-                n->type       = TOML_FLOAT;
-                n->scientific = true;
-            }
-        }
+    if( len>1 && s[ 0 ]=='0' && ( s[ 1 ]=='x' || s[ 1 ]=='o' || s[ 1 ]=='b' ) ) {
+        int  base   = ( s[ 1 ]=='x' ) ? 16 : ( s[ 1 ]=='o' ) ? 8 : 2;
+        bool ok     = parse_base_uint( s+2, len-2, base, &n->integer );
+        RETURN_IF_FAILED( ok, "invalid non-decimal number\n" );
+        *d          = ( double )n->integer;
         next_token( tok );
+        return n;
     }
-    char*  end;
-    double num = strtod( value, &end );
-    RETURN_IF_FAILED( end==value+idx, "could not convert %s to double\n", value );
-    *d = num;
-    if( n->precision>0 ) n->precision--;
-    if( n->type==TOML_INT && num!=0 ) {
-        RETURN_IF_FAILED( value[ 0 ]!='0', "cannot have leading zero for integers" );
-        if( value[ 0 ]=='+' || value[ 0 ]=='-' ) {
-            RETURN_IF_FAILED( value[ 1 ]!='0', "cannot have leading zero for signed integers" );
-        }
+    double f        = parse_inf_nan( s, len );
+    if( f!=0 ) {
+        *d          = f;
+        n->type     = TOML_FLOAT;
+        next_token( tok );
+        return n;
     }
+    // the digits are read once, into a mantissa that is
+    // either the integer or, after a point or exponent,
+    // scaled to a float
+    decimal_t dec   = { 0 };
+    size_t    i     = 0;
+    int       kept;
+    if( s[ 0 ]=='+' || s[ 0 ]=='-' ) {
+        dec.negative    = ( s[ 0 ]=='-' );
+        i++;
+    }
+    size_t start    = i;
+    int    digits   = scan_digits( s, len, &i, &dec, &kept );
+    RETURN_IF_FAILED( digits>0, "could not convert %.*s to a number\n", ( int )len, s );
+    RETURN_IF_FAILED( s[ start ]!='0' || digits==1, "cannot have leading zero for numbers\n" );
+    dec.exponent    = digits-kept;
+    if( i<len && is_decimalpoint( s[ i ] ) ) {
+        n->type         = TOML_FLOAT;
+        // the precision counts everything after the point
+        for( size_t j=i+1; j<len; j++ ) {
+            if( !is_underscore( s[ j ] ) ) n->precision++;
+        }
+        i++;
+        digits          = scan_digits( s, len, &i, &dec, &kept );
+        RETURN_IF_FAILED( digits>0, "expected digits after the decimal point\n" );
+        dec.exponent   -= kept;
+    }
+    if( i<len && ( s[ i ]=='e' || s[ i ]=='E' ) ) {
+        n->type         = TOML_FLOAT;
+        n->scientific   = true;
+        bool negative   = false;
+        i++;
+        if( i<len && ( s[ i ]=='+' || s[ i ]=='-' ) ) {
+            negative    = ( s[ i ]=='-' );
+            i++;
+        }
+        // exponents this large are all zero or infinity
+        decimal_t exp   = { 0 };
+        digits          = scan_digits( s, len, &i, &exp, &kept );
+        RETURN_IF_FAILED( digits>0, "expected digits in the exponent\n" );
+        int64_t   e     = ( digits>kept || exp.mantissa>100000 ) ? 100000 : ( int64_t )exp.mantissa;
+        dec.exponent   += negative ? -e : e;
+    }
+    RETURN_IF_FAILED( i==len, "invalid number, found stray character %c\n", s[ i ] );
+    if( n->type==TOML_INT ) {
+        uint64_t limit  = dec.negative ? ( uint64_t )INT64_MAX+1 : ( uint64_t )INT64_MAX;
+        RETURN_IF_FAILED( dec.exponent==0 && dec.mantissa<=limit,
+                          "%.*s does not fit in 64 bits\n", ( int )len, s );
+        n->integer      = ( dec.negative && dec.mantissa ) ?
+                          -( int64_t )( dec.mantissa-1 )-1 : ( int64_t )dec.mantissa;
+        *d              = ( double )n->integer;
+    }
+    else if( !decimal_to_double( &dec, d ) ) {
+        bool ok         = parse_float_slow( s, len, d );
+        RETURN_IF_FAILED( ok, "could not convert %.*s to double\n", ( int )len, s );
+    }
+    next_token( tok );
     return n;
 }
 
 toml_value_t*
-parse_value(
-    tokenizer_t* tok,
-    const char*  num_end
-) {
-    while( has_token( tok ) ) {
-        RETURN_IF_FAILED( !parse_newline( tok ), "got a newline before any value\n" );
-        if( is_whitespace( get_token( tok ) ) ) {
-            parse_whitespace( tok );
-            continue;
-        }
-        else if( is_basicstringstart( get_token( tok ) ) ) {
-            char  value[ TOML_MAX_STRING_LENGTH ] = { 0 };
-            char* s;
-            next_token( tok );
-            if( has_token( tok ) && is_basicstringstart( get_token( tok ) ) ) {
-                next_token( tok );
-                if( has_token( tok ) && is_basicstringstart( get_token( tok ) ) ) {
-                    next_token( tok );
-                    s = parse_basicstring( tok, value, true );
-                }
-                else if( is_whitespace( get_token( tok ) ) || parse_newline( tok ) ) {
-                    s = value;
-                }
-                else {
-                    LOG_ERR( "cannot start string with 2 double-quotes\n" );
-                    break;
-                }
-            }
-            else {
-                s = parse_basicstring( tok, value, false );
-            }
-            RETURN_IF_FAILED( s, "could not parse basic string\n" );
-            toml_value_t* v = new_string( value );
-            return v;
-        }
-        else if( is_literalstringstart( get_token( tok ) ) ) {
-            char  value[ TOML_MAX_STRING_LENGTH ] = { 0 };
-            char* s;
-            next_token( tok );
-            if( has_token( tok ) && is_literalstringstart( get_token( tok ) ) ) {
-                next_token( tok );
-                if( has_token( tok ) && is_literalstringstart( get_token( tok ) ) ) {
-                    next_token( tok );
-                    s = parse_literalstring( tok, value, true );
-                }
-                else if( is_whitespace( get_token( tok ) ) || parse_newline( tok ) ) {
-                    s = value;
-                }
-                else {
-                    LOG_ERR( "cannot start string with 2 single-quotes\n" );
-                    break;
-                }
-            }
-            else {
-                s = parse_literalstring( tok, value, false );
-            }
-            RETURN_IF_FAILED( s, "could not parse literal string\n" );
-            toml_value_t* v = new_string( value );
-            return v;
-        }
-        else if( is_numberstart( get_token( tok ) ) ) {
-            char value[ TOML_MAX_STRING_LENGTH ] = { 0 };
-            // try parsing date time
-            bool a = next_token( tok );
-            bool b = next_token( tok );
-            if( has_token( tok ) && get_token( tok )==':' ) {
-                backtrack( tok, a+b );
-                struct tm* time = calloc( 1, sizeof( struct tm ) );
-                datetime_t* dt  = parse_datetime( tok, value, num_end, time );
-                FUNC_IF_FAILED(   dt, free, time );
-                RETURN_IF_FAILED( dt, "could not parse time\n" );
-                toml_value_t* v = new_datetime( dt->dt, dt->type, dt->format, dt->millis );
-                free( dt );
-                free( time );
-                return v;
-            }
-            else if( !is_digit( get_prev( tok ) ) || !is_digit( get_token( tok ) ) ) {
-                backtrack( tok, a+b );
-            }
-            else {
-                bool c = next_token( tok );
-                bool d = next_token( tok );
-                if( has_token( tok ) && get_token( tok )=='-' ) {
-                    backtrack( tok, a+b+c+d );
-                    struct tm* time = calloc( 1, sizeof( struct tm ) );
-                    datetime_t* dt  = parse_datetime( tok, value, num_end, time );
-                    FUNC_IF_FAILED(   dt, free, time );
-                    RETURN_IF_FAILED( dt, "could not parse datetime\n" );
-                    toml_value_t* v = new_datetime( dt->dt, dt->type, dt->format, dt->millis );
-                    free( dt );
-                    free( time );
-                    return v;
-                }
-                else {
-                    backtrack( tok, a+b+c+d );
-                }
-            }
-            double*   d   = calloc( 1, sizeof( double ) );
-            number_t* num = calloc( 1, sizeof( number_t ) );
-            number_t* n   = parse_number( tok, value, d, num_end, num );
-            FUNC_IF_FAILED(   n, free, d );
-            FUNC_IF_FAILED(   n, free, n );
-            RETURN_IF_FAILED( n, "could not parse number\n" );
-            toml_value_t* v = new_number( d, n->type, n->precision, n->scientific );
-            free( d );
-            free( n );
-            return v;
-        }
-        else if( is_arraystart( get_token( tok ) ) ) {
-            toml_value_t* v = new_array();
-            next_token( tok );
-            toml_value_t* val = parse_array( tok, v );
-            FUNC_IF_FAILED(   val, delete_value, v  );
-            RETURN_IF_FAILED( val, "could not parse array\n" );
-            return val;
-        }
-        else if( is_inlinetablestart( get_token( tok ) ) ) {
-            next_token( tok );
-            toml_key_t* keys = parse_inlinetable( tok );
-            RETURN_IF_FAILED( keys, "could not parse inline table\n" );
-            toml_value_t* v  = new_inline_table( keys );
-            return v;
-        }
-        else if( get_token( tok )=='t' || get_token( tok )=='f' ) {
-            double b        = parse_boolean( tok );
-            RETURN_IF_FAILED( ( b==1 || b==0 ), "expecting true or false but could not parse\n" );
-            toml_value_t* v = new_number( &b, TOML_BOOL, 0, false );
-            return v;
-        }
-        else if( get_token( tok )=='i' || get_token( tok )=='n' ) {
-            double f        = parse_inf_nan( tok, false );
-            RETURN_IF_FAILED( f, "expecting inf or nan but could not parse\n" );
-            toml_value_t* v = new_number( &f, TOML_FLOAT, 0, false );
-            return v;
-        }
-        else {
-            LOG_ERR( "unknown value type\n" );
-            break;
-        }
+parse_value( tokenizer_t* tok ) {
+    parse_whitespace( tok );
+    lex_value( tok );
+    if( parse_newline( tok ) || !has_token( tok ) ) {
+        LOG_ERR( "got a newline before any value\n" );
+    }
+    else if( get_token( tok )==TOKEN_BASICSTRING ||
+             get_token( tok )==TOKEN_MLBASICSTRING ) {
+        // strings are decoded straight into the arena
+        size_t len;
+        char*  value    = arena_alloc( current_arena, get_length( tok )+1 );
+        RETURN_IF_FAILED( value, "could not allocate string\n" );
+        char*  s        = parse_basicstring( tok, value,
+                                             get_token( tok )==TOKEN_MLBASICSTRING, &len );
+        RETURN_IF_FAILED( s, "could not parse basic string\n" );
+        toml_value_t* v = new_string( value, len );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_LITERALSTRING ||
+             get_token( tok )==TOKEN_MLLITERALSTRING ) {
+        size_t len;
+        char*  value    = arena_alloc( current_arena, get_length( tok )+1 );
+        RETURN_IF_FAILED( value, "could not allocate string\n" );
+        char*  s        = parse_literalstring( tok, value,
+                                               get_token( tok )==TOKEN_MLLITERALSTRING, &len );
+        RETURN_IF_FAILED( s, "could not parse literal string\n" );
+        toml_value_t* v = new_string( value, len );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_DATETIME ) {
+        toml_datetime_t dt;
+        RETURN_IF_FAILED( parse_datetime( tok, &dt ), "could not parse datetime\n" );
+        toml_value_t*   v = new_datetime( &dt );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_NUMBER ) {
+        double    d;
+        number_t  num;
+        number_t* n   = parse_number( tok, &d, &num );
+        RETURN_IF_FAILED( n, "could not parse number\n" );
+        toml_value_t* v = ( n->type==TOML_INT ) ?
+                          new_integer( n->integer ) :
+                          new_float( d, n->precision, n->scientific );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_LBRACKET ) {
+        toml_value_t* v = new_array();
+        next_token( tok );
+        toml_value_t* val = parse_array( tok, v );
+        RETURN_IF_FAILED( val, "could not parse array\n" );
+        return val;
+    }
+    else if( get_token( tok )==TOKEN_LBRACE ) {
+        next_token( tok );
+        toml_key_t* keys = parse_inlinetable( tok );
+        RETURN_IF_FAILED( keys, "could not parse inline table\n" );
+        toml_value_t* v  = new_inline_table( keys );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_BOOL ) {
+        bool          b;
+        RETURN_IF_FAILED( parse_boolean( tok, &b ), "could not parse boolean\n" );
+        toml_value_t* v = new_bool( b );
+        return v;
+    }
+    else if( get_token( tok )==TOKEN_INVALID ) {
+        LOG_ERR( "%s", tok->error );
+    }
+    else {
+        LOG_ERR( "unknown value type\n" );
     }
     return NULL;
 }
@@ -8,41 +8,35 @@
     for holding a parsed FLOAT and INT type
     numbers. It also holds precision for FLOATS
     which is mostly needed for compliance testing.
+    INTS are kept in full in `integer`.
 */
 typedef struct number number_t;
 struct
 number {
     toml_value_type_t type;
+    int64_t           integer;
     int               precision;
     bool              scientific;
 };
 
-/*
-    Struct `datetime` creates a generic type
-    for holding parsed DATETIME, DATETIMELOCAL,
-    DATELOCAL and TIMELOCAL values. It also stores
-    the matching format, again for compliance testing.
-*/
-typedef struct datetime datetime_t;
-struct
-datetime {
-    struct tm*        dt;
-    toml_value_type_t type;
-    char              format[ TOML_MAX_DATE_FORMAT ];
-    int               millis;
-};
-
 /*
     Functions `parse_<TYPE>` parses a TOML value of type
-    TYPE. They take the tokenizer and parses one character
-    at a time. Numerical values and datetimes have a list
-    of characters to mark the end of parsing. Strings take
-    in pre-allocated buffers. Arrays repeatedly parse values.
-    Inline tables repeatedly parse key-value pairs. Everything
-    returns a pointer to what it parsed and NULL on parsing
-    failure. `parse_comment` returns true if a valid comment
-    was parsed and `parse_newline` returns true if a newline
-    was successfully parsed.
+    TYPE from the current token and move on to the next
+    one. Strings, numbers and datetimes are read from the
+    span of a single token. Strings are decoded into the
+    buffer `value`, which has to hold `get_length( tok )+1`
+    chars since decoding never makes a string longer, and
+    their length is stored in `len`. Integers are summed
+    up digit by digit as they are checked, failing if they
+    do not fit in an `int64_t`. Datetimes are read field
+    by field in a single pass and packed into `dt`.
+    Arrays repeatedly
+    parse values. Inline tables
+    repeatedly parse key-value pairs. Everything returns a
+    pointer to what it parsed and NULL on parsing failure.
+    `parse_comment` returns true if a valid comment was
+    parsed and `parse_newline` returns true if the current
+    token is a newline, without moving past it.
 */
 bool
 parse_comment    ( tokenizer_t* tok );
@@ -53,22 +47,36 @@ parse_whitespace ( tokenizer_t* tok );
 bool
 parse_newline    ( tokenizer_t* tok );
 
-double
-parse_boolean    ( tokenizer_t* tok );
+bool*
+parse_boolean(
+    tokenizer_t* tok,
+    bool*        b
+);
 
 toml_key_t*
 parse_inlinetable( tokenizer_t* tok );
 
+/*
+    Functions `parse_escape` and `parse_unicode` decode
+    an escape sequence starting at `c`, right after the
+    backslash, into `escaped` which can hold `len` chars.
+    They move `c` past the sequence and return the number
+    of chars written, or 0 if the sequence is invalid.
+    `parse_unicode` reads exactly `digits` hex digits.
+*/
 int
 parse_escape(
-    tokenizer_t* tok,
+    const char** c,
+    const char*  end,
     char*        escaped,
     int          len
 );
 
 int
 parse_unicode(
-    tokenizer_t* tok,
+    const char** c,
+    const char*  end,
+    int          digits,
     char*        escaped,
     int          len
 );
@@ -77,45 +85,43 @@ char*
 parse_basicstring(
     tokenizer_t* tok,
     char*        value,
-    bool         multi
+    bool         multi,
+    size_t*      len
 );
 
 char*
 parse_literalstring(
     tokenizer_t* tok,
     char*        value,
-    bool         multi
+    bool         multi,
+    size_t*      len
 );
 
 double
 parse_inf_nan(
-    tokenizer_t* tok,
-    bool         negative
+    const char*  s,
+    size_t       len
 );
 
-double
+bool
 parse_base_uint(
-    tokenizer_t* tok,
+    const char*  s,
+    size_t       len,
     int          base,
-    char*        value,
-    const char*  num_end
+    int64_t*     i
 );
 
 number_t*
 parse_number(
     tokenizer_t* tok,
-    char*        value,
     double*      d,
-    const char*  num_end,
     number_t*    n
 );
 
-datetime_t*
+toml_datetime_t*
 parse_datetime(
-    tokenizer_t* tok,
-    char*        value,
-    const char*  num_end,
-    struct tm*   time
+    tokenizer_t*     tok,
+    toml_datetime_t* dt
 );
 
 toml_value_t*
@@ -125,20 +131,13 @@ parse_array(
 );
 
 /*
-    Function `parse_value` looks at a character
-    and decides what `TYPE` it is. Depending on that,
-    it calls the appropriate `parse_<TYPE>` function.
-    Since the `num_end` character set changes based
-    on parsing context (for example, a number can end
-    when we see a `,` when parsing an array), this
-    is added as an argument to this function. This
-    allows it to be used anywhere a value needs to be
-    parsed.
+    Function `parse_value` skips any whitespace, reads
+    the current token as a value and decides what `TYPE`
+    it is. Depending on that, it calls the appropriate
+    `parse_<TYPE>` function. This allows it to be used
+    anywhere a value needs to be parsed.
 */
 toml_value_t*
-parse_value(
-    tokenizer_t* tok,
-    const char*  num_end
-);
+parse_value( tokenizer_t* tok );
 
 #endif
@@ -56,15 +56,17 @@ YELLOW='\033[0;33m'
 GREEN='\033[0;32m'
 NC='\033[0m'
 
-DIR=$(realpath $(realpath $0)/../..)
+DIR=$(realpath $(dirname $(realpath $0))/..)
 LOG=$DIR/tests/test.log
 OLD_STATUS=$DIR/tests/tomlibc.status
 NEW_STATUS=$OLD_STATUS.new
 BINARY=$DIR/tests/test
+SMALL=$DIR/tests/test_small
 
 cd $DIR
 > $NEW_STATUS
 make test > $LOG
+make test_small >> $LOG
 
 cd $DIR/tests
 echo "$(date)" >> $LOG
@@ -73,57 +75,265 @@ echo "Running tomlibc tests" | tee $LOG
 echo "==================" | tee $LOG
 
 JSON=test.json
-# valid
-if [[ -z $TYPE || "$TYPE" == "valid" ]]; then
-    echo "VALID" >> $LOG
+
+# Function `report` records test `$1` as passed if `$2` is 0
+report()
+{
+    if [[ $2 -eq 0 ]]; then
+        PASSED+=( $1 )
+        printf "[${GREEN}PASSED${NC}]: ${1}\n"
+        echo $1 >> $NEW_STATUS
+    else
+        FAILED+=( $1 )
+        printf "[${RED}FAILED${NC}]: ${1}\n"
+    fi
+    echo >> $LOG
+}
+
+# Function `run_driver` runs the driver `$1` with the flag `$2` on
+# the file `$3`. The flag `-` pipes the file into the driver, which
+# then reads it through the window instead of mapping it
+run_driver()
+{
+    if [[ "$2" == "-" ]]; then
+        cat $3 | $1
+    else
+        $1 $2 $3
+    fi
+}
+
+# Function `run_corpus` runs the valid and invalid test files
+# through the driver `$1` with the flag `$2`, and adds `$3` to
+# the names of the tests
+run_corpus()
+{
+    local bin=$1
+    local flag=$2
+    local suffix=$3
+    # valid
+    if [[ -z $TYPE || "$TYPE" == "valid" ]]; then
+        echo "VALID$suffix" >> $LOG
+        echo "=====" >> $LOG
+        echo >> $LOG
+        for test in $(ls valid/*$MATCH*.toml);
+        do
+            TOTAL=$(( TOTAL+1 ))
+            echo $test$suffix >> $LOG
+            echo "=================" >> $LOG
+            echo >> $LOG
+            run_driver $bin "$flag" $test 2>>$LOG | tee $JSON >/dev/null
+            test ${PIPESTATUS[0]} -eq 0 || echo "$test$suffix: [FAILED]"
+            json="${test%.toml}.json"
+            diff <(jq --sort-keys . $json 2>>$LOG) <(jq --sort-keys . $JSON 2>>$LOG) >> $LOG
+            report $test$suffix $?
+        done
+    fi
+
+    # invalid
+    if [[ -z $TYPE || "$TYPE" == "invalid" ]]; then
+        echo "INVALID$suffix" >> $LOG
+        echo "=======" >> $LOG
+        echo >> $LOG
+        for test in $(ls invalid/*$MATCH*.toml);
+        do
+            TOTAL=$(( TOTAL+1 ))
+            echo $test$suffix >> $LOG
+            echo "=================" >> $LOG
+            echo >> $LOG
+            run_driver $bin "$flag" $test >> $LOG 2>/dev/null
+            test $? -eq 1
+            report $test$suffix $?
+        done
+    fi
+}
+
+run_corpus $BINARY
+# `toml_load_buffer` on a range that is not terminated, with and
+# without the index
+run_corpus $BINARY --buffer @buffer
+run_corpus $SMALL --buffer @buffer-indexed
+# small files mapped and indexed, and split at every header
+run_corpus $SMALL "" @mapped
+run_corpus $SMALL --parallel @parallel
+# piped input, the small window grows for nearly every token
+run_corpus $BINARY - @pipe
+run_corpus $SMALL - @pipe-small
+
+# Function `check_output` runs the driver with the flag `$2` on
+# the file `$1`, and checks its status against `$3` and its output
+# against the expected lines read from stdin. `$4` is appended to
+# the reported name and `$5` to the arguments
+check_output()
+{
+    TOTAL=$(( TOTAL+1 ))
+    echo $1$4 >> $LOG
+    echo "=================" >> $LOG
+    echo >> $LOG
+    $BINARY $2 $1 $5 2>>$LOG > $JSON
+    test $? -eq $3 && diff - $JSON >> $LOG
+    report $1$4 $?
+}
+
+# events: the events of every file in events/ are compared with
+# the expected ones in the .out file, which marks the strings that
+# are views of the input. Files named *-error* fail after their
+# last expected event, and parsing stopped early never fails
+if [[ -z $TYPE ]]; then
+    echo "EVENTS" >> $LOG
+    echo "======" >> $LOG
+    echo >> $LOG
+    for test in $(ls events/*$MATCH*.toml);
+    do
+        out="${test%.toml}.out"
+        status=0
+        [[ $test == *-error* ]] && status=1
+        check_output $test --events-buffer $status @buffer < $out
+        # strings read from a file are not marked
+        check_output $test --events $status < <(sed 's/ (view)$\| (copy)$//' $out)
+        check_output $test --events-buffer 0 @stop 5 < <(head -n 5 $out)
+    done
+fi
+
+# records: the entries of `a.b` in every file in records/ have to
+# be the ones `toml_load` finds. Files with a line starting with
+# `# error` fail after the entries before it, which are compared
+# with those of the file up to that line
+if [[ -z $TYPE ]]; then
+    echo "RECORDS" >> $LOG
+    echo "=======" >> $LOG
+    echo >> $LOG
+    for test in $(ls records/*$MATCH*.toml);
+    do
+        TOTAL=$(( TOTAL+1 ))
+        echo $test >> $LOG
+        echo "=================" >> $LOG
+        echo >> $LOG
+        status=0
+        grep -q "^# error" $test && status=1
+        $BINARY --records a.b $test 2>>$LOG > $JSON
+        test $? -eq $status &&
+        diff <(sed '/^# error/,$d' $test | $BINARY 2>>$LOG | jq --sort-keys .a.b 2>>$LOG) \
+             <(jq --sort-keys . $JSON 2>>$LOG) >> $LOG
+        report $test $?
+    done
+fi
+
+# large: inputs past the limits that were once fixed, generated
+# here along with the JSON they have to give. The array has more
+# elements than the 131072 that used to fit in its 1 MB
+if [[ -z $TYPE ]]; then
+    echo "LARGE" >> $LOG
+    echo "=====" >> $LOG
+    echo >> $LOG
+    LARGE=large.toml
+    awk 'BEGIN { printf "a = [ "; for( i=0; i<200000; i++ ) printf "%d, ", i; print "]" }' > $LARGE
+    jq -n '{ a: [ range( 200000 ) | { type: "integer", value: tostring } ] }' > $LARGE.json
+    for flag in "" --buffer -;
+    do
+        name=large-array
+        [[ $flag == --buffer ]] && name=$name@buffer
+        [[ $flag == - ]] && name=$name@pipe
+        TOTAL=$(( TOTAL+1 ))
+        echo $name >> $LOG
+        echo "=================" >> $LOG
+        echo >> $LOG
+        run_driver $BINARY "$flag" $LARGE 2>>$LOG > $JSON
+        test $? -eq 0 &&
+        diff <(jq --sort-keys . $LARGE.json 2>>$LOG) <(jq --sort-keys . $JSON 2>>$LOG) >> $LOG
+        report $name $?
+    done
+    rm -f $LARGE $LARGE.json
+fi
+
+# paths: every .args file in paths/ names an input file on its
+# first line and the paths to load from it on the others. The keys
+# that are loaded are compared with the .json file, and loading
+# has to fail if there is none
+if [[ -z $TYPE ]]; then
+    echo "PATHS" >> $LOG
     echo "=====" >> $LOG
     echo >> $LOG
-    for test in $(ls valid/*$MATCH*.toml);
+    for test in $(ls paths/*$MATCH*.args);
     do
         TOTAL=$(( TOTAL+1 ))
         echo $test >> $LOG
         echo "=================" >> $LOG
         echo >> $LOG
-        $BINARY $test 2>>$LOG | tee $JSON >/dev/null
-        test $? -eq 0 || echo "$test: [FAILED]"
-        json="${test%.toml}.json"
-        diff <(jq --sort-keys . $json 2>>$LOG) <(jq --sort-keys . $JSON 2>>$LOG) >> $LOG
+        args=( $(cat $test) )
+        $BINARY --paths paths/${args[0]} "${args[@]:1}" 2>>$LOG > $JSON
         r=$?
-        if [[ $r -eq 0 ]]; then
-            PASSED+=( $test )
-            printf "[${GREEN}PASSED${NC}]: ${test}\n"
-            echo $test >> $NEW_STATUS
+        json="${test%.args}.json"
+        if [[ -f $json ]]; then
+            test $r -eq 0 &&
+            diff <(jq --sort-keys . $json 2>>$LOG) <(jq --sort-keys . $JSON 2>>$LOG) >> $LOG
         else
-            FAILED+=( $test )
-            printf "[${RED}FAILED${NC}]: ${test}\n"
+            test $r -eq 1
         fi
-        echo >> $LOG
+        report $test $?
     done
 fi
 
-# invalid
-if [[ -z $TYPE || "$TYPE" == "invalid" ]]; then
-    echo "INVALID" >> $LOG
+# getters: every .args file in getters/ lists the keys of the .toml
+# file next to it, whose values as the typed getters return them
+# are compared with the .out file
+if [[ -z $TYPE ]]; then
+    echo "GETTERS" >> $LOG
     echo "=======" >> $LOG
     echo >> $LOG
-    for test in $(ls invalid/*$MATCH*.toml);
+    for test in $(ls getters/*$MATCH*.toml);
+    do
+        check_output $test --get 0 "" "$(cat ${test%.toml}.args)" < ${test%.toml}.out
+    done
+fi
+
+# parallel: `toml_load_parallel` has to print the same JSON and
+# the same errors as `toml_load` for every test file and for the
+# files in parallel/, which test what is merged across chunks
+if [[ -z $TYPE ]]; then
+    echo "PARALLEL" >> $LOG
+    echo "========" >> $LOG
+    echo >> $LOG
+    for test in $(ls valid/*$MATCH*.toml invalid/*$MATCH*.toml parallel/*$MATCH*.toml);
     do
         TOTAL=$(( TOTAL+1 ))
-        echo $test >> $LOG
+        echo $test@serial >> $LOG
         echo "=================" >> $LOG
         echo >> $LOG
-        $BINARY $test >> $LOG 2>/dev/null
+        $BINARY $test > $JSON.serial 2> $JSON.serial.err
         r=$?
-        if [[ $r -eq 1 ]]; then
-            PASSED+=( $test )
-            printf "[${GREEN}PASSED${NC}]: ${test}\n"
-            echo $test >> $NEW_STATUS
-        else
-            FAILED+=( $test )
-            printf "[${RED}FAILED${NC}]: ${test}\n"
-        fi
+        $SMALL --parallel $test > $JSON 2> $JSON.err
+        test $? -eq $r &&
+        diff $JSON.serial $JSON >> $LOG &&
+        diff $JSON.serial.err $JSON.err >> $LOG
+        report $test@serial $?
+    done
+    rm -f $JSON.serial $JSON.serial.err $JSON.err
+fi
+
+# many: `toml_load_many` loads a batch of test files, which has to
+# print the JSON and errors `toml_load` prints for each file, and
+# fails if one of them does
+if [[ -z $TYPE ]]; then
+    echo "MANY" >> $LOG
+    echo "====" >> $LOG
+    echo >> $LOG
+    for batch in "valid" "valid invalid";
+    do
+        TOTAL=$(( TOTAL+1 ))
+        echo "many: $batch" >> $LOG
+        echo "=================" >> $LOG
         echo >> $LOG
+        files=$(for dir in $batch; do ls $dir/*$MATCH*.toml; done)
+        status=0
+        [[ $batch == *invalid* ]] && status=1
+        for test in $files; do $BINARY $test; done > $JSON.serial 2> $JSON.serial.err
+        $BINARY --many $files > $JSON 2> $JSON.err
+        test $? -eq $status &&
+        diff $JSON.serial $JSON >> $LOG &&
+        diff $JSON.serial.err $JSON.err >> $LOG
+        report "many:${batch// /+}" $?
     done
+    rm -f $JSON.serial $JSON.serial.err $JSON.err
 fi
 
 if [[ $TOTAL -gt 0 ]]; then
@@ -1,14 +1,343 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "../tomlib.h"
 
+/*
+    Usage: test [FILE]
+           test --buffer FILE
+           test --parallel FILE
+           test --events FILE [STOP]
+           test --events-buffer FILE [STOP]
+           test --records PATH FILE
+           test --paths FILE PATH...
+           test --many FILE...
+           test --get FILE KEY...
+
+    Without a flag, FILE or stdin is loaded with
+    `toml_load` and printed as JSON. The `--buffer` and
+    `--parallel` modes load FILE through other entry
+    points and print the same JSON, so their output can
+    be compared with the expected one of every test
+    file. The `--paths` mode prints only the keys of
+    FILE that the dotted PATHs select.
+
+    The `--events` modes print the events of FILE one per
+    line, and stop after STOP events if it is given.
+
+    The `--records` mode prints the entries of the array
+    of tables PATH in FILE as a JSON array, and fails if
+    the iterator ended on an error.
+
+    The `--many` mode loads all FILEs at once and prints
+    the JSON of each one that loaded to stdout and the
+    errors of the others to stderr, in the order given.
+
+    The `--get` mode prints what the typed getters return
+    for each top-level KEY of FILE, one KEY per line.
+*/
+
+/*
+    Function `read_file` returns the contents of `file`,
+    freed with `free`, and stores their length in `len`.
+*/
+static char*
+read_file(
+    const char* file,
+    size_t*     len
+) {
+    FILE* f     = fopen( file, "rb" );
+    if( !f ) {
+        fprintf( stderr, "could not open %s\n", file );
+        return NULL;
+    }
+    char*  data = NULL;
+    size_t size = 0;
+    *len        = 0;
+    for( ;; ) {
+        if( *len==size ) {
+            size    = size ? size*2 : 4096;
+            char* d = realloc( data, size );
+            if( !d ) {
+                free( data );
+                fclose( f );
+                return NULL;
+            }
+            data    = d;
+        }
+        size_t n    = fread( data+*len, 1, size-*len, f );
+        if( n==0 ) {
+            break;
+        }
+        *len       += n;
+    }
+    fclose( f );
+    return data;
+}
+
+/*
+    Function `load_guarded` loads `file` with
+    `toml_load_buffer` from a range at the end of a
+    larger buffer, which is followed by a page that
+    cannot be read. The range is not terminated, so
+    reading past its length crashes the test.
+*/
+static toml_key_t*
+load_guarded( const char* file ) {
+    size_t len;
+    char*  data     = read_file( file, &len );
+    if( !data ) {
+        return NULL;
+    }
+    size_t page     = ( size_t )sysconf( _SC_PAGESIZE );
+    size_t size     = ( len/page+2 )*page;
+    char*  buffer   = mmap( NULL, size+page, PROT_READ|PROT_WRITE,
+                            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+    if( buffer==MAP_FAILED ) {
+        free( data );
+        return NULL;
+    }
+    // what comes before the range is not part of it either
+    memset( buffer, '[', size );
+    char*  range    = buffer+size-len;
+    memcpy( range, data, len );
+    free( data );
+    mprotect( buffer+size, page, PROT_NONE );
+    toml_key_t* toml    = toml_load_buffer( range, len );
+    munmap( buffer, size+page );
+    return toml;
+}
+
+/*
+    Struct `events` is what `print_event` is registered
+    with. Strings that point into the `len` characters
+    at `buffer` are marked as views of the input, the
+    others were decoded. Printing stops once `stop`
+    events were printed, if it is positive.
+*/
+typedef struct events events_t;
+struct
+events {
+    const char* buffer;
+    size_t      len;
+    int         count;
+    int         stop;
+};
+
+static const char*
+event_names[] = {
+    "TABLE", "ARRAYTABLE", "KEY", "VALUE",
+    "ARRAY_BEGIN", "ARRAY_END",
+    "INLINETABLE_BEGIN", "INLINETABLE_END",
+};
+
+static const char*
+value_names[] = {
+    "string", "integer", "float", "bool", "datetime",
+    "datetime-local", "date-local", "time-local",
+};
+
+static bool
+print_event(
+    const toml_event_t* e,
+    void*               data
+) {
+    events_t* ev    = data;
+    printf( "%s", event_names[ e->type ] );
+    if( e->type==TOML_EVENT_TABLE || e->type==TOML_EVENT_ARRAYTABLE ||
+        e->type==TOML_EVENT_KEY ) {
+        printf( " %d ", e->depth );
+        for( int i=0; i<e->depth; i++ ) {
+            printf( i ? ".\"%s\"" : "\"%s\"", e->path[ i ] );
+        }
+    }
+    else if( e->type==TOML_EVENT_VALUE ) {
+        printf( " %s ", value_names[ e->value ] );
+        switch( e->value ) {
+            case TOML_STRING:
+                printf( "\"%.*s\"", ( int )e->len, e->string );
+                if( ev->buffer ) {
+                    bool view   = e->string>=ev->buffer &&
+                                  e->string<ev->buffer+ev->len;
+                    printf( view ? " (view)" : " (copy)" );
+                }
+                break;
+            case TOML_INT:
+                printf( "%lld", ( long long )e->integer );
+                break;
+            case TOML_FLOAT:
+                printf( "%.17g", e->number );
+                break;
+            case TOML_BOOL:
+                printf( e->boolean ? "true" : "false" );
+                break;
+            default:
+                printf( "%lld %d %d", ( long long )e->datetime->epoch,
+                        e->datetime->nanos, e->datetime->offset );
+                break;
+        }
+    }
+    printf( "\n" );
+    return ++ev->count!=ev->stop;
+}
+
+/*
+    Function `print_events` prints the events of `file`,
+    from a copy in memory if `buffer` is set.
+*/
+static bool
+print_events(
+    char* file,
+    bool  buffer,
+    int   stop
+) {
+    events_t ev = { NULL, 0, 0, stop };
+    if( !buffer ) {
+        return toml_parse_events( file, print_event, &ev );
+    }
+    char*    data   = read_file( file, &ev.len );
+    if( !data ) {
+        return false;
+    }
+    ev.buffer       = data;
+    bool     ok     = toml_parse_events_buffer( data, ev.len, print_event, &ev );
+    free( data );
+    return ok;
+}
+
+static bool
+print_records(
+    char*       file,
+    const char* path
+) {
+    toml_records_t* r   = toml_records_open( file, path );
+    if( !r ) {
+        return false;
+    }
+    printf( "[\n" );
+    toml_key_t*     record;
+    for( int i=0; ( record=toml_records_next( r ) ); i++ ) {
+        if( i ) {
+            printf( ",\n" );
+        }
+        toml_json_dump( record );
+    }
+    printf( "]\n" );
+    bool            ok  = !toml_records_failed( r );
+    toml_records_close( r );
+    return ok;
+}
+
+static bool
+print_many(
+    char** files,
+    size_t n
+) {
+    toml_result_t* results  = calloc( n, sizeof( toml_result_t ) );
+    if( !results ) {
+        return false;
+    }
+    bool           ok       = toml_load_many( files, n, results, 4 );
+    for( size_t i=0; i<n; i++ ) {
+        if( results[ i ].root ) {
+            toml_json_dump( results[ i ].root );
+            toml_free( results[ i ].root );
+        }
+        if( results[ i ].error ) {
+            fputs( results[ i ].error, stderr );
+            free( results[ i ].error );
+        }
+    }
+    free( results );
+    return ok;
+}
+
+/*
+    Function `print_getters` prints the value of each key
+    in `ids` as the getter of its type returns it. Integers
+    are printed from both `toml_get_int64` and `toml_get_int`,
+    and datetimes both packed and as `toml_datetime_tm`
+    fills them.
+*/
+static bool
+print_getters(
+    char*  file,
+    char** ids,
+    int    n
+) {
+    toml_key_t* toml    = toml_load( file );
+    if( !toml ) {
+        return false;
+    }
+    for( int i=0; i<n; i++ ) {
+        toml_key_t*      key    = toml_get_key( toml, ids[ i ] );
+        int64_t*         i64    = toml_get_int64( key );
+        double*          f      = toml_get_float( key );
+        bool*            b      = toml_get_bool( key );
+        char*            s      = toml_get_string( key );
+        toml_datetime_t* dt     = toml_get_datetime( key );
+        printf( "%s", ids[ i ] );
+        if( i64 ) {
+            int*         narrow = toml_get_int( key );
+            printf( " int64 %lld int ", ( long long )*i64 );
+            narrow ? printf( "%d", *narrow ) : printf( "NULL" );
+        }
+        else if( f ) {
+            printf( " float %.17g", *f );
+        }
+        else if( b ) {
+            printf( " bool %s", *b ? "true" : "false" );
+        }
+        else if( s ) {
+            printf( " string \"%s\"", s );
+        }
+        else if( dt ) {
+            struct tm    tm;
+            toml_datetime_tm( dt, &tm );
+            printf( " datetime %lld %d %d %04d-%02d-%02d %02d:%02d:%02d %ld",
+                    ( long long )dt->epoch, dt->nanos, dt->offset,
+                    tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, ( long )tm.tm_gmtoff );
+        }
+        else {
+            printf( " NULL" );
+        }
+        printf( "\n" );
+    }
+    toml_free( toml );
+    return true;
+}
+
 int main( int argc, char* argv[], char** envp )
 {
     char* file = NULL;
-    if( argc > 1 )
-        file = argv[1];
-    toml_key_t* toml = toml_load( file );
+    toml_key_t* toml;
+    if( argc > 2 && strncmp( argv[1], "--events", 8 )==0 ) {
+        int stop = argc > 3 ? atoi( argv[3] ) : 0;
+        bool ok  = print_events( argv[2], strcmp( argv[1], "--events-buffer" )==0, stop );
+        return ok ? 0 : 1;
+    }
+    if( argc > 2 && strcmp( argv[1], "--many" )==0 )
+        return print_many( argv+2, argc-2 ) ? 0 : 1;
+    if( argc > 2 && strcmp( argv[1], "--get" )==0 )
+        return print_getters( argv[2], argv+3, argc-3 ) ? 0 : 1;
+    if( argc > 3 && strcmp( argv[1], "--records" )==0 )
+        return print_records( argv[3], argv[2] ) ? 0 : 1;
+    if( argc > 2 && strcmp( argv[1], "--buffer" )==0 )
+        toml = load_guarded( argv[2] );
+    else if( argc > 2 && strcmp( argv[1], "--parallel" )==0 )
+        toml = toml_load_parallel( argv[2], 4 );
+    else if( argc > 2 && strcmp( argv[1], "--paths" )==0 )
+        toml = toml_load_paths( argv[2], ( const char* const* )argv+3, argc-3 );
+    else {
+        if( argc > 1 )
+            file = argv[1];
+        toml = toml_load( file );
+    }
     if( toml==NULL )
         return 1;
     toml_json_dump( toml );
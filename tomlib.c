@@ -1,43 +1,861 @@
 #include "tomlib.h"
 
 #include "parser/lib/tokenizer.h"
+#include "parser/lib/indexer.h"
 #include "parser/lib/utils.h"
 #include "parser/lib/key.h"
+#include "parser/lib/value.h"
 
 #include "parser/parse_keys.h"
+#include "parser/parse_values.h"
+#include "parser/parse_events.h"
+#include "parser/parse_utils.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <inttypes.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+static toml_key_t*
+toml_parse_tokens(
+    tokenizer_t* tok,
+    const char*  name
+) {
+    toml_key_t* root = new_root();
+    RETURN_IF_FAILED( root, "could not allocate %s\n", name );
+    arena_t*    prev = use_arena( root_arena( root ) );
+
+    next_token( tok );
+
+    toml_key_t* key = root;
+    while( has_token( tok )!=0 && key ) {
+        key  = parse_keyval( tok, key, root );
+    }
+    use_arena( prev );
+    if( !key ) {
+        size_t line, col;
+        get_position( tok, &line, &col );
+        toml_free( root );
+        LOG_ERR( "Encountered an error while parsing %s\n"
+                 "At line %zu column %zu\n",
+                 name, line, col );
+        return NULL;
+    }
+    return root;
+}
+
+static toml_key_t*
+toml_parse(
+    tokenizer_t* tok,
+    const char*  name
+) {
+    toml_key_t* root = toml_parse_tokens( tok, name );
+    delete_tokenizer( tok );
+    return root;
+}
 
 toml_key_t*
 toml_load( char* file ) {
-    toml_key_t* root = new_key( TOML_TABLE );
-    memcpy( root->id, "root", strlen( "root" ) );
+    tokenizer_t* tok = new_tokenizer( file );
+    bool         ok  = load_input( tok );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
+    RETURN_IF_FAILED( ok, "Failed to load input from %s\n", file );
+    return toml_parse( tok, file ? file : "stdin" );
+}
+
+toml_key_t*
+toml_load_stream( FILE* stream ) {
+    tokenizer_t* tok = new_tokenizer( NULL );
+    bool         ok  = load_stream( tok, stream );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
+    RETURN_IF_FAILED( ok, "Failed to load input from stream\n" );
+    return toml_parse( tok, "stream" );
+}
+
+toml_key_t*
+toml_load_buffer(
+    const char* data,
+    size_t      len
+) {
+    tokenizer_t* tok = new_tokenizer( NULL );
+    bool         ok  = load_buffer( tok, data, len );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
+    RETURN_IF_FAILED( ok, "Failed to load input from buffer\n" );
+    return toml_parse( tok, "buffer" );
+}
+
+/*
+    Inputs are only split into parts of at least
+    `PARALLEL_MIN_SIZE` characters, smaller parts are
+    parsed faster than they are merged. The tests build
+    with a lower value to split small inputs as well.
+*/
+#ifndef PARALLEL_MIN_SIZE
+#define PARALLEL_MIN_SIZE 1048576   // 2^20
+#endif
+
+/*
+    Struct `chunk` is a part of the input that starts at
+    a table header, or at the start of the input, and is
+    parsed into a tree of its own.
+*/
+typedef struct chunk chunk_t;
+struct
+chunk {
+    const char* data;
+    size_t      len;
+    toml_key_t* root;
+};
+
+/*
+    Struct `chunks` is shared by the threads parsing the
+    chunks, which take the next one from `next` until
+    there are none left.
+*/
+typedef struct chunks chunks_t;
+struct
+chunks {
+    chunk_t* parts;
+    size_t   n;
+    size_t   next;
+};
+
+/*
+    The errors of a chunk are found again by the serial
+    parser, which reports them at the right position, so
+    they are not logged while parsing in parallel.
+*/
+static FILE*
+mute_log() {
+    FILE* prev  = log_output;
+    log_output  = fopen( "/dev/null", "w" );
+    return prev;
+}
+
+static void
+unmute_log( FILE* prev ) {
+    if( log_output ) {
+        fclose( log_output );
+    }
+    log_output  = prev;
+}
+
+static void*
+parse_chunks( void* arg ) {
+    chunks_t* c     = arg;
+    FILE*     prev  = mute_log();
+    size_t    i;
+    while( ( i=__atomic_fetch_add( &c->next, 1, __ATOMIC_RELAXED ) )<c->n ) {
+        tokenizer_t* tok    = new_tokenizer( NULL );
+        if( load_buffer( tok, c->parts[ i ].data, c->parts[ i ].len ) ) {
+            c->parts[ i ].root  = toml_parse( tok, "chunk" );
+        }
+        else {
+            delete_tokenizer( tok );
+        }
+    }
+    unmute_log( prev );
+    return NULL;
+}
+
+/*
+    Function `toml_parse_parallel` splits the `len`
+    characters of `data` at table headers, parses the
+    chunks on up to `threads` threads and merges their
+    trees in input order, so the keys are checked for
+    re-definitions in that order too. Returns NULL if
+    the input could not be split, or if a chunk could
+    not be parsed or merged.
+*/
+static toml_key_t*
+toml_parse_parallel(
+    const char* data,
+    size_t      len,
+    int         threads
+) {
+    size_t n = len/PARALLEL_MIN_SIZE;
+    if( n>( size_t )threads*4 ) {
+        n = ( size_t )threads*4;
+    }
+    if( n<2 ) {
+        return NULL;
+    }
+    size_t*    splits   = calloc( n-1, sizeof( size_t ) );
+    chunk_t*   parts    = calloc( n, sizeof( chunk_t ) );
+    pthread_t* pool     = calloc( threads, sizeof( pthread_t ) );
+    if( splits && parts && pool ) {
+        n = split_input( data, len, len/n, splits, n-1 )+1;
+    }
+    else {
+        n = 1;
+    }
+    if( n<2 ) {
+        free( splits );
+        free( parts );
+        free( pool );
+        return NULL;
+    }
+    for( size_t i=0; i<n; i++ ) {
+        size_t start    = i==0 ? 0 : splits[ i-1 ];
+        size_t end      = i==n-1 ? len : splits[ i ];
+        parts[ i ].data = data+start;
+        parts[ i ].len  = end-start;
+    }
+    free( splits );
+
+    // the calling thread parses chunks as well
+    chunks_t c          = { parts, n, 0 };
+    int      started    = 0;
+    while( started<threads-1 && started<( int )n-1 &&
+           pthread_create( &pool[ started ], NULL, parse_chunks, &c )==0 ) {
+        started++;
+    }
+    parse_chunks( &c );
+    for( int i=0; i<started; i++ ) {
+        pthread_join( pool[ i ], NULL );
+    }
+    free( pool );
+
+    // the keys of the chunks are merged into the first
+    // tree, whose arena takes over the arenas of the rest
+    toml_key_t* root    = parts[ 0 ].root;
+    arena_t*    prev    = root ? use_arena( root_arena( root ) ) : current_arena;
+    for( size_t i=1; i<n; i++ ) {
+        if( root && parts[ i ].root ) {
+            arena_adopt( root_arena( root ), root_arena( parts[ i ].root ) );
+            if( merge_subkeys( root, parts[ i ].root ) ) {
+                continue;
+            }
+        }
+        else {
+            toml_free( parts[ i ].root );
+        }
+        toml_free( root );
+        root    = NULL;
+    }
+    use_arena( prev );
+    free( parts );
+    return root;
+}
+
+toml_key_t*
+toml_load_parallel(
+    char* file,
+    int   threads
+) {
+    const char*  name   = file ? file : "stdin";
+    tokenizer_t* tok    = new_tokenizer( file );
+    // the chunks are indexed on their own
+    tok->indexing       = false;
+    bool         ok     = load_input( tok );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
+    RETURN_IF_FAILED( ok, "Failed to load input from %s\n", file );
+    // only an input that is fully in memory can be split
+    if( !tok->eof || tok->offset!=0 ) {
+        return toml_parse( tok, name );
+    }
+    if( threads<=0 ) {
+        threads         = ( int )sysconf( _SC_NPROCESSORS_ONLN );
+    }
+    FILE*        prev   = mute_log();
+    toml_key_t*  root   = threads>1 ? toml_parse_parallel( tok->stream, tok->len, threads )
+                                    : NULL;
+    unmute_log( prev );
+    if( !root ) {
+        // chunks that only fail on their own, like tables
+        // of an array of tables started in an earlier
+        // chunk, are parsed again as a whole
+        tokenizer_t* whole  = new_tokenizer( NULL );
+        load_buffer( whole, tok->stream, tok->len );
+        root            = toml_parse( whole, name );
+    }
+    delete_tokenizer( tok );
+    return root;
+}
+
+/*
+    Struct `batch` is shared by the threads of
+    `toml_load_many`, which take the next file from
+    `next` until there are none left.
+*/
+typedef struct batch batch_t;
+struct
+batch {
+    char**         paths;
+    toml_result_t* results;
+    size_t         n;
+    size_t         next;
+    /* number of files that could not be loaded */
+    size_t         failed;
+};
+
+static void*
+load_files( void* arg ) {
+    batch_t*     b      = arg;
+    // the tokenizer and its window, and the stream the
+    // errors are captured in, are reused for every file
+    tokenizer_t* tok    = new_tokenizer( NULL );
+    char*        errors = NULL;
+    size_t       size   = 0;
+    FILE*        prev   = log_output;
+    log_output          = open_memstream( &errors, &size );
+    size_t       i;
+    while( ( i=__atomic_fetch_add( &b->next, 1, __ATOMIC_RELAXED ) )<b->n ) {
+        toml_result_t* r    = &b->results[ i ];
+        reset_tokenizer( tok, b->paths[ i ] );
+        if( load_input( tok ) ) {
+            r->root     = toml_parse_tokens( tok, b->paths[ i ] );
+        }
+        else {
+            LOG_ERR( "Failed to load input from %s\n", b->paths[ i ] );
+            r->root     = NULL;
+        }
+        r->error        = NULL;
+        if( log_output ) {
+            fflush( log_output );
+            off_t len   = ftello( log_output );
+            if( len>0 ) {
+                r->error    = strndup( errors, ( size_t )len );
+            }
+            fseeko( log_output, 0, SEEK_SET );
+        }
+        if( !r->root ) {
+            __atomic_fetch_add( &b->failed, 1, __ATOMIC_RELAXED );
+        }
+    }
+    if( log_output ) {
+        fclose( log_output );
+    }
+    free( errors );
+    log_output          = prev;
+    delete_tokenizer( tok );
+    return NULL;
+}
+
+bool
+toml_load_many(
+    char**         paths,
+    size_t         n,
+    toml_result_t* results,
+    int            threads
+) {
+    if( threads<=0 ) {
+        threads     = ( int )sysconf( _SC_NPROCESSORS_ONLN );
+    }
+    batch_t    b        = { paths, results, n, 0, 0 };
+    pthread_t* pool     = calloc( threads, sizeof( pthread_t ) );
+    int        started  = 0;
+    // the calling thread loads files as well
+    while( pool && started<threads-1 && ( size_t )started+1<n &&
+           pthread_create( &pool[ started ], NULL, load_files, &b )==0 ) {
+        started++;
+    }
+    load_files( &b );
+    for( int i=0; i<started; i++ ) {
+        pthread_join( pool[ i ], NULL );
+    }
+    free( pool );
+    return b.failed==0;
+}
+
+static bool
+toml_parse_events_from(
+    tokenizer_t*         tok,
+    const char*          name,
+    toml_event_handler_t handler,
+    void*                data
+) {
+    events_t ev = { 0 };
+    ev.handler  = handler;
+    ev.data     = data;
+
+    next_token( tok );
+
+    size_t line, col;
+    while( has_token( tok ) && !ev.stopped ) {
+        if( !parse_keyval_events( tok, &ev ) && !ev.stopped ) {
+            get_position( tok, &line, &col );
+            delete_tokenizer( tok );
+            free( ev.ids );
+            LOG_ERR( "Encountered an error while parsing %s\n"
+                     "At line %zu column %zu\n",
+                     name, line, col );
+            return false;
+        }
+    }
+
+    delete_tokenizer( tok );
+    free( ev.ids );
+    return true;
+}
 
+bool
+toml_parse_events(
+    char*                file,
+    toml_event_handler_t handler,
+    void*                data
+) {
     tokenizer_t* tok = new_tokenizer( file );
     bool         ok  = load_input( tok );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
     RETURN_IF_FAILED( ok, "Failed to load input from %s\n", file );
+    return toml_parse_events_from( tok, file ? file : "stdin", handler, data );
+}
+
+bool
+toml_parse_events_buffer(
+    const char*          buffer,
+    size_t               len,
+    toml_event_handler_t handler,
+    void*                data
+) {
+    tokenizer_t* tok = new_tokenizer( NULL );
+    bool         ok  = load_buffer( tok, buffer, len );
+    FUNC_IF_FAILED(   ok, delete_tokenizer, tok );
+    RETURN_IF_FAILED( ok, "Failed to load input from buffer\n" );
+    return toml_parse_events_from( tok, "buffer", handler, data );
+}
+
+/*
+    Function `split_path` copies the dotted `path` into
+    `ids`, freed with `free`, with the dots replaced by
+    NULs and `parts` pointing at each of them. Returns the
+    number of parts, which is not positive if the path has
+    too many parts or could not be copied.
+*/
+static int
+split_path(
+    const char*  path,
+    char**       ids,
+    const char** parts
+) {
+    *ids      = strdup( path );
+    int depth = 0;
+    for( char* p=*ids; p; depth++ ) {
+        if( depth>=TOML_MAX_KEY_DEPTH ) {
+            return -1;
+        }
+        char* dot       = strchr( p, '.' );
+        parts[ depth ]  = p;
+        if( dot ) {
+            *dot        = '\0';
+        }
+        p = dot ? dot+1 : NULL;
+    }
+    return depth;
+}
+
+/*
+    Struct `toml_records` holds the state of a record
+    iterator between calls to `toml_records_next`.
+*/
+struct
+toml_records {
+    tokenizer_t* tok;
+    const char*  name;
+    /* parser state for the parts outside the records */
+    events_t     ev;
+    /* the parts of the path of the records */
+    char*        ids;
+    const char*  path[ TOML_MAX_KEY_DEPTH ];
+    int          depth;
+    /* tree holding the last returned record */
+    toml_key_t*  root;
+    /* true if the header of the next record was read */
+    bool         pending;
+    bool         failed;
+};
+
+toml_records_t*
+toml_records_open(
+    char*       file,
+    const char* path
+) {
+    toml_records_t* r = calloc( 1, sizeof( toml_records_t ) );
+    RETURN_IF_FAILED( r, "could not allocate records\n" );
+    r->depth        = split_path( path, &r->ids, r->path );
+    if( r->depth<=0 ) {
+        LOG_ERR( "invalid path %s\n", path );
+        free( r->ids );
+        free( r );
+        return NULL;
+    }
+    r->name         = file ? file : "stdin";
+    r->tok          = new_tokenizer( file );
+    // an index grows with the input, records must not
+    r->tok->indexing    = false;
+    bool ok         = load_input( r->tok );
+    if( !ok ) {
+        LOG_ERR( "Failed to load input from %s\n", r->name );
+        delete_tokenizer( r->tok );
+        free( r->ids );
+        free( r );
+        return NULL;
+    }
+    r->ev.handler   = NULL;
+    next_token( r->tok );
+    return r;
+}
+
+static bool
+is_record(
+    toml_records_t*     r,
+    const toml_event_t* e,
+    bool                prefix
+) {
+    if( e->depth<r->depth || ( !prefix && e->depth!=r->depth ) ) {
+        return false;
+    }
+    for( int i=0; i<r->depth; i++ ) {
+        if( strcmp( e->path[ i ], r->path[ i ] )!=0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static toml_key_t*
+records_error( toml_records_t* r ) {
+    size_t line, col;
+    get_position( r->tok, &line, &col );
+    r->failed = true;
+    LOG_ERR( "Encountered an error while parsing %s\n"
+             "At line %zu column %zu\n",
+             r->name, line, col );
+    return NULL;
+}
+
+/*
+    Function `parse_record` parses the record whose header
+    was just read, along with its subtables, into `r->root`.
+*/
+static toml_key_t*
+parse_record( toml_records_t* r ) {
+    toml_key_t*  key    = add_table_path( r->root, r->path, r->depth, true );
+    if( !key ) {
+        return records_error( r );
+    }
+    tokenizer_t* tok    = r->tok;
+    toml_key_t*  record = key->value->arr[ key->idx ]->data;
+    toml_event_t e;
+    while( has_token( tok ) ) {
+        if( get_token( tok )==TOKEN_LBRACKET ) {
+            if( !parse_header_events( tok, &r->ev, &e ) ) {
+                return records_error( r );
+            }
+            if( !is_record( r, &e, true ) || e.depth==r->depth ) {
+                // a header outside the record ends it
+                r->pending  = ( e.type==TOML_EVENT_ARRAYTABLE && is_record( r, &e, false ) );
+                break;
+            }
+            key     = add_table_path( r->root, e.path, e.depth,
+                                      e.type==TOML_EVENT_ARRAYTABLE );
+        }
+        else {
+            key     = parse_keyval( tok, key, r->root );
+        }
+        if( !key ) {
+            return records_error( r );
+        }
+    }
+    return record;
+}
+
+toml_key_t*
+toml_records_next( toml_records_t* r ) {
+    if( !r ) {
+        return NULL;
+    }
+    toml_free( r->root );
+    r->root         = NULL;
+    if( r->failed ) {
+        return NULL;
+    }
+    tokenizer_t* tok    = r->tok;
+    toml_event_t e;
+    // skip everything up to the header of the next record
+    while( !r->pending ) {
+        if( !has_token( tok ) ) {
+            return NULL;
+        }
+        if( get_token( tok )==TOKEN_LBRACKET ) {
+            if( !parse_header_events( tok, &r->ev, &e ) ) {
+                return records_error( r );
+            }
+            r->pending  = ( e.type==TOML_EVENT_ARRAYTABLE && is_record( r, &e, false ) );
+        }
+        else if( !parse_keyval_events( tok, &r->ev ) ) {
+            return records_error( r );
+        }
+    }
+    r->pending      = false;
+    release_input( tok );
+
+    // the record is parsed into a tree of its own, so the
+    // subtables of the record resolve the same way they
+    // would in the whole input
+    r->root         = new_root();
+    if( !r->root ) {
+        return records_error( r );
+    }
+    arena_t*    prev    = use_arena( root_arena( r->root ) );
+    toml_key_t* record  = parse_record( r );
+    use_arena( prev );
+    return record;
+}
+
+bool
+toml_records_failed( toml_records_t* r ) {
+    return !r || r->failed;
+}
+
+void
+toml_records_close( toml_records_t* r ) {
+    if( !r ) {
+        return;
+    }
+    toml_free( r->root );
+    delete_tokenizer( r->tok );
+    free( r->ev.ids );
+    free( r->ids );
+    free( r );
+}
+
+/*
+    Struct `selection` is one of the paths requested from
+    `toml_load_paths`. It is resolved once nothing after
+    the current position can change what it selects.
+*/
+typedef struct selection selection_t;
+struct
+selection {
+    char*       ids;
+    const char* path[ TOML_MAX_KEY_DEPTH ];
+    int         depth;
+    bool        resolved;
+};
+
+/*
+    Struct `projection` holds the state of `toml_load_paths`.
+    The path of the last table header and the dotted key
+    being parsed are decoded by two separate event parsers,
+    so the key does not overwrite the header.
+*/
+typedef struct projection projection_t;
+struct
+projection {
+    events_t     table;
+    events_t     key;
+    selection_t* sel;
+    size_t       n;
+    size_t       resolved;
+};
+
+/*
+    A key is selected if its path, which is the path of
+    the `table` it is in followed by the `depth` parts of
+    `path`, and one of the requested paths start the same,
+    so the requested keys, their subkeys and the tables
+    leading to them are the ones that get built. `within`
+    is set if the key is a requested one or one of its
+    subkeys, rather than only leading to one.
+*/
+static bool
+is_selected(
+    projection_t*       p,
+    const toml_event_t* table,
+    const char* const*  path,
+    int                 depth,
+    bool*               within
+) {
+    bool selected   = false;
+    *within         = false;
+    for( size_t i=0; i<p->n; i++ ) {
+        selection_t* s  = &p->sel[ i ];
+        int          j  = 0;
+        for( ; j<s->depth && j<table->depth+depth; j++ ) {
+            const char* id  = j<table->depth ? table->path[ j ]
+                                             : path[ j-table->depth ];
+            if( strcmp( id, s->path[ j ] )!=0 ) {
+                break;
+            }
+        }
+        if( j==s->depth ) {
+            *within     = true;
+            return true;
+        }
+        selected       |= j==table->depth+depth;
+    }
+    return selected;
+}
+
+/*
+    A requested path is resolved once it leads to a
+    `KEYLEAF`, or past one without finding the key, since
+    keys and tables cannot be added to a `KEYLEAF` later
+    on. Tables can still get subtables from later headers
+    and arrays of tables can still get entries, so those
+    are never resolved.
+*/
+static void
+update_resolved(
+    projection_t* p,
+    toml_key_t*   root
+) {
+    for( size_t i=0; i<p->n; i++ ) {
+        selection_t* s  = &p->sel[ i ];
+        if( s->resolved ) {
+            continue;
+        }
+        toml_key_t*  k  = root;
+        bool         found  = true;
+        for( int j=0; j<s->depth && found && k->type!=TOML_ARRAYTABLE; j++ ) {
+            toml_key_t* sub = find_subkey( k, s->path[ j ], strlen( s->path[ j ] ) );
+            if( !sub ) {
+                found   = false;
+            }
+            else {
+                k       = sub;
+            }
+        }
+        if( k->type==TOML_KEYLEAF ) {
+            s->resolved = true;
+            p->resolved++;
+        }
+    }
+}
+
+static toml_key_t*
+toml_parse_paths(
+    tokenizer_t*  tok,
+    const char*   name,
+    projection_t* p
+) {
+    toml_key_t* root = new_root();
+    FUNC_IF_FAILED(   root, delete_tokenizer, tok );
+    RETURN_IF_FAILED( root, "could not allocate %s\n", name );
+    arena_t*    prev = use_arena( root_arena( root ) );
+
     next_token( tok );
 
-    int line, col;
-    toml_key_t* key = root;
-    while( has_token( tok )!=0 ) {
-        key  = parse_keyval( tok, key, root );
-        line = tok->line;
-        col  = tok->col;
-        FUNC_IF_FAILED(   key, delete_tokenizer, tok );
-        FUNC_IF_FAILED(   key, toml_free, root );
-        RETURN_IF_FAILED( key, "Encountered an error while parsing %s\n"
-                          "At line %d column %d\n",
-                          file, line+1, col );
+    // keys after a header that is not selected are only
+    // checked for syntax, which `key` being NULL marks
+    toml_key_t*  key    = root;
+    toml_event_t table  = { 0 };
+    bool         ok     = true;
+    bool         within;
+    while( has_token( tok ) && p->resolved<p->n && ok ) {
+        if( get_token( tok )==TOKEN_LBRACKET ) {
+            ok      = parse_header_events( tok, &p->table, &table );
+            key     = NULL;
+            if( ok && is_selected( p, &table, NULL, 0, &within ) ) {
+                key = add_table_path( root, table.path, table.depth,
+                                      table.type==TOML_EVENT_ARRAYTABLE );
+                ok  = key!=NULL;
+            }
+        }
+        else if( key && tok->newline &&
+                 get_token( tok )!=TOKEN_COMMENT &&
+                 get_token( tok )!=TOKEN_WHITESPACE &&
+                 !parse_newline( tok ) ) {
+            tok->newline    = false;
+            int depth;
+            ok      = parse_path_events( tok, &p->key, TOKEN_EQUAL, &depth );
+            if( ok ) {
+                next_token( tok );
+                bool selected   = is_selected( p, &table, p->key.path, depth, &within );
+                // a key leading to a requested one only matters
+                // if it is an inline table that could hold it
+                if( selected && !within ) {
+                    parse_whitespace( tok );
+                    lex_value( tok );
+                    selected    = get_token( tok )==TOKEN_LBRACE;
+                }
+                if( selected ) {
+                    ok  = parse_pathval( tok, key, p->key.path, depth )!=NULL;
+                    update_resolved( p, root );
+                }
+                else {
+                    ok  = parse_value_events( tok, &p->key );
+                    parse_whitespace( tok );
+                }
+            }
+        }
+        else {
+            ok      = parse_keyval_events( tok, &p->key );
+        }
+    }
+    use_arena( prev );
+    if( !ok ) {
+        size_t line, col;
+        get_position( tok, &line, &col );
+        delete_tokenizer( tok );
+        toml_free( root );
+        LOG_ERR( "Encountered an error while parsing %s\n"
+                 "At line %zu column %zu\n",
+                 name, line, col );
+        return NULL;
     }
 
     delete_tokenizer( tok );
     return root;
 }
 
+toml_key_t*
+toml_load_paths(
+    char*              file,
+    const char* const* paths,
+    size_t             n
+) {
+    projection_t* p = calloc( 1, sizeof( projection_t ) );
+    RETURN_IF_FAILED( p, "could not allocate projection\n" );
+    selection_t*  sel   = calloc( n ? n : 1, sizeof( selection_t ) );
+    FUNC_IF_FAILED(   sel, free, p );
+    RETURN_IF_FAILED( sel, "could not allocate projection\n" );
+    p->sel          = sel;
+    p->n            = n;
+    toml_key_t* root    = NULL;
+    bool        ok      = true;
+    for( size_t i=0; i<n && ok; i++ ) {
+        selection_t* s  = &p->sel[ i ];
+        s->depth        = split_path( paths[ i ], &s->ids, s->path );
+        // `a.*` selects the same keys as `a`
+        if( s->depth>1 && strcmp( s->path[ s->depth-1 ], "*" )==0 ) {
+            s->depth--;
+        }
+        ok              = s->depth>0;
+        if( !ok ) {
+            LOG_ERR( "invalid path %s\n", paths[ i ] );
+        }
+    }
+    if( ok ) {
+        tokenizer_t* tok    = new_tokenizer( file );
+        // the index is built from the whole input up
+        // front, which would undo stopping early
+        tok->indexing       = false;
+        if( load_input( tok ) ) {
+            root    = toml_parse_paths( tok, file ? file : "stdin", p );
+        }
+        else {
+            delete_tokenizer( tok );
+            LOG_ERR( "Failed to load input from %s\n", file );
+        }
+    }
+    for( size_t i=0; i<n; i++ ) {
+        free( p->sel[ i ].ids );
+    }
+    free( p->table.ids );
+    free( p->key.ids );
+    free( p->sel );
+    free( p );
+    return root;
+}
+
 toml_key_t*
 toml_get_key(
     toml_key_t* key,
@@ -49,9 +867,9 @@ toml_get_key(
     if( strcmp( key->id, id )==0 ) {
         return key;
     }
-    khiter_t k = kh_get( str, key->subkeys, id );
-    if( k!=kh_end( key->subkeys ) ) {
-        return kh_value( key->subkeys, k );
+    toml_key_t* k = find_subkey( key, id, strlen( id ) );
+    if( k ) {
+        return k;
     }
     LOG_ERR( "node %s does not exist in subkeys of node %s",
              id, key->id );
@@ -69,11 +887,18 @@ toml_get_string( toml_key_t* key ) {
 
 int*
 toml_get_int( toml_key_t* key ) {
+    int64_t* i = toml_get_int64( key );
+    if( !i )                                    return NULL;
+    if( !( *i>=INT_MIN && *i<=INT_MAX ) )       return NULL;
+    return &key->value->narrow;
+}
+
+int64_t*
+toml_get_int64( toml_key_t* key ) {
     if( !key )                                  return NULL;
     if( !( key->value ) )                       return NULL;
     if( !( key->value->type==TOML_INT ) )       return NULL;
-    if( !( key->value->data ) )                 return NULL;
-    return ( int* )( key->value->data );
+    return &key->value->integer;
 }
 
 double*
@@ -81,8 +906,7 @@ toml_get_float( toml_key_t* key ) {
     if( !key )                                  return NULL;
     if( !( key->value ) )                       return NULL;
     if( !( key->value->type==TOML_FLOAT ) )     return NULL;
-    if( !( key->value->data ) )                 return NULL;
-    return ( double* )( key->value->data );
+    return &key->value->number;
 }
 
 bool*
@@ -90,11 +914,10 @@ toml_get_bool( toml_key_t* key ) {
     if( !key )                                  return NULL;
     if( !( key->value ) )                       return NULL;
     if( !( key->value->type==TOML_BOOL ) )      return NULL;
-    if( !( key->value->data ) )                 return NULL;
-    return ( bool* )( key->value->data );
+    return &key->value->boolean;
 }
 
-struct tm*
+toml_datetime_t*
 toml_get_datetime( toml_key_t* key ) {
     if( !key )                                  return NULL;
     if( !( key->value ) )                       return NULL;
@@ -102,8 +925,34 @@ toml_get_datetime( toml_key_t* key ) {
            key->value->type==TOML_DATETIMELOCAL ||
            key->value->type==TOML_DATELOCAL     ||
            key->value->type==TOML_TIMELOCAL ) ) return NULL;
-    if( !( key->value->data ) )                 return NULL;
-    return ( struct tm* )( key->value->data );
+    return &key->value->datetime;
+}
+
+struct tm*
+toml_datetime_tm(
+    const toml_datetime_t* dt,
+    struct tm*             tm
+) {
+    // the date and time as they were written, before the
+    // offset was taken out
+    int64_t local   = dt->epoch+dt->offset*60;
+    int64_t days    = ( local>=0 ? local : local-( 24*60*60-1 ) )/( 24*60*60 );
+    int64_t secs    = local-days*24*60*60;
+    int     year    = 1900;
+    int     month   = 1;
+    int     day     = 1;
+    if( dt->kind!=TOML_TIMELOCAL ) {
+        civil_from_days( days, &year, &month, &day );
+    }
+    memset( tm, 0, sizeof( struct tm ) );
+    tm->tm_year     = year-1900;
+    tm->tm_mon      = month-1;
+    tm->tm_mday     = day;
+    tm->tm_hour     = ( int )( secs/( 60*60 ) );
+    tm->tm_min      = ( int )( secs/60%60 );
+    tm->tm_sec      = ( int )( secs%60 );
+    tm->tm_gmtoff   = dt->offset*60;
+    return tm;
 }
 
 toml_value_t*
@@ -114,9 +963,17 @@ toml_get_array( toml_key_t* key ) {
     return key->value;
 }
 
+/*
+    Function `string_dump` prints the `len` chars of `s`
+    as the body of a JSON string. Keys and strings can
+    hold escaped NULs, so the length is what ends them.
+*/
 static inline void
-string_dump( const char* s ) {
-    for( const char* c=s; *c!='\0'; c++ ) {
+string_dump(
+    const char* s,
+    size_t      len
+) {
+    for( const char* c=s; c<s+len; c++ ) {
         switch ( *c ) {
             case '\b':
                 printf( "\\b" );
@@ -140,6 +997,10 @@ string_dump( const char* s ) {
                 printf( "\\\"" );
                 continue;
             default:
+                if( ( unsigned char )*c<0x20 ) {
+                    printf( "\\u%04x", *c );
+                    continue;
+                }
                 break;
         }
         printf( "%c", *c );
@@ -152,18 +1013,18 @@ toml_key_dump( toml_key_t* k ) {
         k->value!=NULL &&
         k->value->type!=TOML_INLINETABLE ) {
         printf( "\"" );
-        string_dump( k->id );
+        string_dump( k->id, k->len );
         printf( "\": " );
         toml_value_dump( k->value );
     }
     else if( k->type==TOML_ARRAYTABLE ) {
         printf( "\"" );
-        string_dump( k->id );
+        string_dump( k->id, k->len );
         printf( "\": [\n" );
-        for( size_t i=0; i<=k->idx; i++ )
+        for( int i=0; i<k->value->len; i++ )
         {
             toml_value_dump( k->value->arr[ i ] );
-            if( i!=k->idx )
+            if( i!=k->value->len-1 )
             {
                 printf( ",\n" );
             }
@@ -172,35 +1033,67 @@ toml_key_dump( toml_key_t* k ) {
     }
     else {
         printf( "\"" );
-        string_dump( k->id );
+        string_dump( k->id, k->len );
         printf( "\": {\n" );
-        int total = kh_size( k->subkeys );
-        for( khiter_t ki=kh_begin( k->subkeys );
-             ki!=kh_end( k->subkeys );
-             ++ki ) {
-            if( kh_exist( k->subkeys, ki ) ) {
-                toml_key_dump( kh_value( k->subkeys, ki ) );
-                if( --total>0 ) {
-                    printf( ",\n" );
-                }
+        int         total   = k->count;
+        size_t      it      = 0;
+        toml_key_t* s;
+        while( ( s=next_subkey( k, &it ) ) ) {
+            toml_key_dump( s );
+            if( --total>0 ) {
+                printf( ",\n" );
             }
         }
         printf( "\n}" );
     }
 }
 
+/*
+    Function `datetime_dump` prints `dt` in RFC 3339 form,
+    with at least milliseconds if it has fractional seconds.
+*/
+static void
+datetime_dump( const toml_datetime_t* dt ) {
+    struct tm tm;
+    toml_datetime_tm( dt, &tm );
+    if( dt->kind!=TOML_TIMELOCAL ) {
+        printf( "%04d-%02d-%02d", tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday );
+    }
+    if( dt->kind==TOML_DATELOCAL ) {
+        return;
+    }
+    if( dt->kind!=TOML_TIMELOCAL ) {
+        printf( "T" );
+    }
+    printf( "%02d:%02d:%02d", tm.tm_hour, tm.tm_min, tm.tm_sec );
+    if( dt->digits ) {
+        char nanos[ 10 ];
+        snprintf( nanos, sizeof( nanos ), "%09d", ( int )dt->nanos );
+        printf( ".%.*s", dt->digits>3 ? ( int )dt->digits : 3, nanos );
+    }
+    if( dt->kind==TOML_DATETIME ) {
+        if( dt->offset==0 ) {
+            printf( "Z" );
+        }
+        else {
+            int off = dt->offset<0 ? -dt->offset : dt->offset;
+            printf( "%c%02d:%02d", dt->offset<0 ? '-' : '+', off/60, off%60 );
+        }
+    }
+}
+
 void
 toml_value_dump( toml_value_t* v ) {
     switch ( v->type ) {
         case TOML_STRING: {
             printf( "{\"type\": \"string\", \"value\": \"" );
-            string_dump( ( char* )v->data );
+            string_dump( ( char* )v->data, ( size_t )v->len );
             printf( "\"}" );
             break;
         }
         case TOML_FLOAT: {
             printf( "{\"type\": \"float\", \"value\": " );
-            double f = *( double* )( v->data );
+            double f = v->number;
             if( f==( double ) INFINITY ) {
                 printf( "\"inf\"}" );
             }
@@ -223,12 +1116,12 @@ toml_value_dump( toml_value_t* v ) {
         }
         case TOML_INT: {
             printf( "{\"type\": \"integer\", \"value\": " );
-            printf( "\"%.0lf\"}", *( double* )( v->data ) );
+            printf( "\"%" PRId64 "\"}", v->integer );
             break;
         }
         case TOML_BOOL: {
             printf( "{\"type\": \"bool\", \"value\": " );
-            if( *( double* )( v->data ) ) {
+            if( v->boolean ) {
                 printf( "\"true\"}" );
             }
             else {
@@ -236,43 +1129,23 @@ toml_value_dump( toml_value_t* v ) {
             }
             break;
         }
-        case TOML_DATETIME: {
-            printf( "{\"type\": \"datetime\", \"value\": " );
-            char buf[ 255 ] = { 0 };
-            strftime( buf, sizeof( buf ), v->format,
-                      ( struct tm* )v->data );
-            printf( "\"%s\"}", buf);
-            break;
-        }
-        case TOML_DATETIMELOCAL: {
-            printf( "{\"type\": \"datetime-local\", \"value\": " );
-            char buf[ 255 ] = { 0 };
-            strftime( buf, sizeof( buf ), v->format,
-                      ( struct tm* )v->data );
-            printf( "\"%s\"}", buf );
-            break;
-        }
-        case TOML_DATELOCAL: {
-            printf( "{\"type\": \"date-local\", \"value\": " );
-            char buf[ 255 ] = { 0 };
-            strftime( buf, sizeof( buf ), v->format,
-                      ( struct tm* )v->data );
-            printf( "\"%s\"}", buf );
-            break;
-        }
+        case TOML_DATETIME:
+        case TOML_DATETIMELOCAL:
+        case TOML_DATELOCAL:
         case TOML_TIMELOCAL: {
-            printf( "{\"type\": \"time-local\", \"value\": " );
-            char buf[ 255 ] = { 0 };
-            strftime( buf, sizeof( buf ), v->format,
-                      ( struct tm* )v->data );
-            printf( "\"%s\"}", buf );
+            printf( "{\"type\": \"%s\", \"value\": \"",
+                    v->type==TOML_DATETIME      ? "datetime" :
+                    v->type==TOML_DATETIMELOCAL ? "datetime-local" :
+                    v->type==TOML_DATELOCAL     ? "date-local" : "time-local" );
+            datetime_dump( &v->datetime );
+            printf( "\"}" );
             break;
         }
         case TOML_ARRAY: {
             printf( "[\n" );
-            for( toml_value_t** iter=v->arr; *iter!=NULL; iter++ ) {
-                toml_value_dump( *iter );
-                if( *( iter+1 )!=NULL ) {
+            for( int i=0; i<v->len; i++ ) {
+                toml_value_dump( v->arr[ i ] );
+                if( i!=v->len-1 ) {
                     printf( ",\n" );
                 }
             }
@@ -282,15 +1155,13 @@ toml_value_dump( toml_value_t* v ) {
         case TOML_INLINETABLE: {
             printf( "{\n" );
             toml_key_t* k = ( toml_key_t* )( v->data );
-            int total = kh_size( k->subkeys );
-            for( khiter_t ki=kh_begin( k->subkeys );
-                 ki!=kh_end( k->subkeys );
-                 ++ki ) {
-                if( kh_exist( k->subkeys, ki ) ) {
-                    toml_key_dump( kh_value( k->subkeys, ki ) );
-                    if( --total>0 ) {
-                        printf( ",\n" );
-                    }
+            int         total   = k->count;
+            size_t      it      = 0;
+            toml_key_t* s;
+            while( ( s=next_subkey( k, &it ) ) ) {
+                toml_key_dump( s );
+                if( --total>0 ) {
+                    printf( ",\n" );
                 }
             }
             printf( "\n}" );
@@ -305,15 +1176,13 @@ toml_value_dump( toml_value_t* v ) {
 void
 toml_json_dump( toml_key_t* root ) {
     printf( "{\n" );
-    int total = kh_size( root->subkeys );
-    for( khiter_t ki=kh_begin( root->subkeys );
-         ki!=kh_end( root->subkeys );
-         ki++ ) {
-        if( kh_exist( root->subkeys, ki ) ) {
-            toml_key_dump( kh_value( root->subkeys, ki ) );
-            if( --total>0 ) {
-                printf( ",\n" );
-            }
+    int         total   = root->count;
+    size_t      it      = 0;
+    toml_key_t* s;
+    while( ( s=next_subkey( root, &it ) ) ) {
+        toml_key_dump( s );
+        if( --total>0 ) {
+            printf( ",\n" );
         }
     }
     printf( "\n}\n" );
@@ -321,5 +1190,5 @@ toml_json_dump( toml_key_t* root ) {
 
 void
 toml_free( toml_key_t* toml ) {
-    delete_key( toml );
+    delete_root( toml );
 }
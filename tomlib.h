@@ -3,6 +3,8 @@
 
 #include "parser/lib/models.h"
 
+#include <stdio.h>
+
 /*
     Function `toml_load` loads a TOML from either
     a file or from stdin if `file` is NULL. It
@@ -14,6 +16,157 @@
 toml_key_t*
 toml_load( char* file );
 
+/*
+    Function `toml_load_stream` is the same as
+    `toml_load` but reads from an already opened
+    `stream`, which is left open. Streams that
+    cannot be mapped into memory, like pipes, are
+    read through a fixed size window, so the memory
+    used for the input does not grow with its size.
+*/
+toml_key_t*
+toml_load_stream( FILE* stream );
+
+/*
+    Function `toml_load_buffer` parses the `len`
+    characters at `data` in place, without copying
+    them. The buffer does not need to be terminated,
+    so it can be a range inside a larger buffer, and
+    it is only read while parsing.
+*/
+toml_key_t*
+toml_load_buffer(
+    const char* data,
+    size_t      len
+);
+
+/*
+    Function `toml_load_parallel` is the same as
+    `toml_load`, but splits large inputs at table headers
+    and parses the parts on `threads` threads, or one per
+    CPU if it is 0 or less. The trees of the parts are
+    merged with the same re-definition rules the serial
+    parser uses. If a part or the merge fails, which can
+    also happen for valid inputs, the input is parsed
+    again as a whole, so the result and any errors are
+    the same as those of `toml_load`.
+*/
+toml_key_t*
+toml_load_parallel(
+    char* file,
+    int   threads
+);
+
+/*
+    Struct `toml_result` is what `toml_load_many`
+    returns for each file.
+*/
+typedef struct toml_result toml_result_t;
+struct
+toml_result {
+    /* the `root` key, NULL if the file could not be loaded */
+    toml_key_t* root;
+    /* the errors logged while loading the file, or NULL if
+       there were none, to be freed with `free` */
+    char*       error;
+};
+
+/*
+    Function `toml_load_many` loads the `n` files in
+    `paths` on `threads` threads, or one per CPU if it
+    is 0 or less, storing the result of `paths[ i ]` in
+    `results[ i ]`. The threads take the files one at
+    a time, so slow files do not hold up the others, and
+    reuse their tokenizer for every file. Errors are
+    kept with the file they belong to instead of being
+    written to stderr. Returns true if every file was
+    loaded.
+*/
+bool
+toml_load_many(
+    char**         paths,
+    size_t         n,
+    toml_result_t* results,
+    int            threads
+);
+
+/*
+    Function `toml_load_paths` loads only the `n` dotted
+    `paths` from `file`, or stdin if `file` is NULL. Keys
+    and tables are built for the requested paths, their
+    subkeys and the tables leading to them, so `"db"`, or
+    `"db.*"`, selects the whole `db` table. Everything else
+    is only checked for syntax, and redefinitions are only
+    detected among the keys that are built. Inline tables
+    leading to a requested path are built whole. Parsing stops
+    as soon as every path leads to a key-value pair, which
+    nothing after it can change. Returns the `root` key,
+    freed with `toml_free`, or NULL on failure.
+*/
+toml_key_t*
+toml_load_paths(
+    char*              file,
+    const char* const* paths,
+    size_t             n
+);
+
+/*
+    Functions `toml_parse_events` and
+    `toml_parse_events_buffer` read the same inputs as
+    `toml_load` and `toml_load_buffer`, but call
+    `handler` with every table header, key and value
+    in the order they appear instead of building keys
+    and values. Only the syntax is checked, so keys
+    that are defined twice are not reported. Parsing
+    stops early if `handler` returns false. Returns
+    false if the input could not be parsed.
+*/
+bool
+toml_parse_events(
+    char*                file,
+    toml_event_handler_t handler,
+    void*                data
+);
+
+bool
+toml_parse_events_buffer(
+    const char*          buffer,
+    size_t               len,
+    toml_event_handler_t handler,
+    void*                data
+);
+
+/*
+    Functions `toml_records_open`, `toml_records_next` and
+    `toml_records_close` iterate over the entries of the
+    array of tables `path` in `file`, or stdin if `file`
+    is NULL. The parts of `path` are separated by dots,
+    so `"a.b"` selects the entries of `[[a.b]]`. Each
+    call to `toml_records_next` parses the next entry
+    with all its subtables and returns it, freeing the
+    previous one, so memory use is bounded by the largest
+    entry instead of the size of the input. Everything
+    outside the entries is only checked for syntax. It
+    returns NULL after the last entry or on a parsing
+    error, which `toml_records_failed` tells apart.
+*/
+typedef struct toml_records toml_records_t;
+
+toml_records_t*
+toml_records_open(
+    char*       file,
+    const char* path
+);
+
+toml_key_t*
+toml_records_next  ( toml_records_t* records );
+
+bool
+toml_records_failed( toml_records_t* records );
+
+void
+toml_records_close ( toml_records_t* records );
+
 /*
     Function `toml_key_dump`, `toml_value_dump` and
     `toml_json_dump` are functions to print out the
@@ -30,7 +183,10 @@ toml_json_dump ( toml_key_t* root );
 
 /*
     Function `toml_free` de-allocates all the memory
-    used up by the TOML data structures.
+    used up by the TOML data structures. Every document
+    is allocated from an arena of its own, so this frees
+    a few blocks instead of walking the tree. It takes
+    the `root` key returned by one of the load functions.
 */
 void
 toml_free( toml_key_t* toml );
@@ -54,18 +210,39 @@ toml_get_key(
 char*
 toml_get_string  ( toml_key_t* key );
 
+/*
+    Function `toml_get_int` returns NULL for integers
+    that do not fit in an `int`, which `toml_get_int64`
+    holds in full.
+*/
 int*
 toml_get_int     ( toml_key_t* key );
 
+int64_t*
+toml_get_int64   ( toml_key_t* key );
+
 double*
 toml_get_float   ( toml_key_t* key );
 
 bool*
 toml_get_bool    ( toml_key_t* key );
 
-struct tm*
+/*
+    Function `toml_get_datetime` returns the packed form of
+    a datetime value, whose `epoch` can be compared as is.
+    Function `toml_datetime_tm` fills `tm` with the date and
+    time as they were written, and the offset in seconds,
+    and returns it.
+*/
+toml_datetime_t*
 toml_get_datetime( toml_key_t* key );
 
+struct tm*
+toml_datetime_tm(
+    const toml_datetime_t* dt,
+    struct tm*             tm
+);
+
 toml_value_t*
 toml_get_array   ( toml_key_t* key );
 